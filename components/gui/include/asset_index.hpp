@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+/// @brief The index of the device-ready assets which the host asset compiler
+///        (host/asset_compiler.cpp) writes into the littlefs image.
+/// The index is a text file with one asset per line:
+///
+///     <kind> <name> <file> <width> <height> <source hash>
+///
+/// where kind is `image` for raw RGB565 pixels (native byte order, packed
+/// rows) at width x height, `bmap` for a BrightnessCache entry of a grid of
+/// width x height cells, or `bmseq` for a BrightnessSequence on such a grid.
+/// The file is relative to the index, and the source hash is
+/// BrightnessCache::hash_file() of the source image (of all the frames of a
+/// sequence), in hex. Lines starting with `#` are comments.
+class AssetIndex {
+public:
+  enum class Kind : uint8_t {
+    IMAGE, //< RGB565 pixels
+    BMAP,  //< BrightnessCache entry
+    BMSEQ, //< BrightnessSequence file
+  };
+
+  struct Entry {
+    Kind kind{Kind::IMAGE};
+    std::string name;   //< Name of the source image, without extension
+    std::string file;   //< File of the asset, relative to the index
+    uint16_t width{0};  //< Pixels for an image, columns for a map or sequence
+    uint16_t height{0}; //< Pixels for an image, rows for a map or sequence
+    uint64_t source_hash{0};
+  };
+
+  /// Name of the index file in the asset directory.
+  static constexpr const char *file_name = "index.txt";
+
+  /// @brief Reads an index file.
+  /// @param file The index file.
+  /// @return False if the file can't be read or has a malformed line.
+  bool load(const std::filesystem::path &file);
+
+  /// @brief Writes the index to a file.
+  /// @param file The index file.
+  /// @return True if the file was written.
+  bool save(const std::filesystem::path &file) const;
+
+  /// @brief Returns the first entry of a kind for a name, nullptr if none.
+  const Entry *find(Kind kind, const std::string &name) const;
+
+  /// @brief Returns all entries, in the order of the file.
+  const std::vector<Entry> &entries() const { return entries_; }
+
+  /// @brief Adds an entry to the index.
+  void add(const Entry &entry) { entries_.push_back(entry); }
+
+protected:
+  std::vector<Entry> entries_;
+};
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+/// @brief Stores computed brightness maps in a directory (e.g. on the
+///        littlefs partition), so an image only has to be decoded and
+///        downsampled the first time it is shown on a given grid.
+/// An entry is keyed by a hash of the source file's contents, the grid size
+/// and the pixel format the source decodes to, so changing any of them just
+/// misses the cache. Entries are written to a temporary file and renamed into
+/// place, so a power cut while storing never leaves a partial entry.
+class BrightnessCache {
+public:
+  struct Key {
+    uint64_t source_hash{0}; //< hash_file() of the source image
+    uint16_t cols{0};        //< Number of columns of the grid
+    uint16_t rows{0};        //< Number of rows of the grid
+    uint8_t format{0};       //< BrightnessMap::Format the source decodes to
+  };
+
+  /// @brief Constructor for the BrightnessCache.
+  /// @param dir Directory the entries are stored in, created when the first
+  ///        entry is stored.
+  explicit BrightnessCache(const std::filesystem::path &dir)
+      : dir_(dir) {}
+
+  /// @brief Returns the 64 bit FNV-1a hash of a file's contents, or 0 if it
+  ///        can't be read.
+  static uint64_t hash_file(const std::filesystem::path &file);
+
+  /// @brief Loads the brightness map stored for a key.
+  /// @param key The key of the entry.
+  /// @param brightness_map Output, cols x rows values.
+  /// @return True if the entry exists and is valid.
+  bool load(const Key &key, std::vector<uint8_t> &brightness_map) const;
+
+  /// @brief Stores the brightness map for a key, replacing any older entry.
+  /// @param key The key of the entry.
+  /// @param brightness_map cols x rows values.
+  /// @return True if the entry was written.
+  bool store(const Key &key, const std::vector<uint8_t> &brightness_map) const;
+
+  /// @brief Returns the path of the entry for a key.
+  std::filesystem::path path_for(const Key &key) const;
+
+protected:
+  static constexpr char magic[4] = {'M', 'R', 'B', 'M'};
+  static constexpr uint8_t version = 1;
+
+  std::filesystem::path dir_;
+};
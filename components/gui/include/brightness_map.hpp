@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/// @brief Downsamples an image to a grid of brightness values, one per
+///        character cell of the rain.
+/// The pixel format is resolved once per image to a row kernel which turns a
+/// whole row of pixels into brightness (luma) values without any per-pixel
+/// branching, so the kernels can be vectorized by the compiler. On Xtensa,
+/// which the compiler doesn't vectorize for, the RGB565 kernels work on two
+/// pixels per 32 bit word instead. Every kernel produces exactly the same
+/// brightness for a pixel.
+/// The scratch buffers of compute() are kept in the object, so computing the
+/// maps of many images (e.g. the frames of a sequence) doesn't allocate once
+/// the buffers are large enough.
+/// This has no dependency on LVGL, so it can be built and profiled on a host.
+class BrightnessMap {
+public:
+  /// Pixel formats, laid out in memory like the LVGL formats of the same name.
+  enum class Format : uint8_t {
+    RGB565,         //< 16 bit, native (little endian) byte order
+    RGB565_SWAPPED, //< 16 bit, bytes swapped (big endian)
+    RGB888,         //< B, G, R bytes
+    ARGB8888,       //< B, G, R, A bytes, brightness is scaled by alpha
+    XRGB8888,       //< B, G, R, X bytes
+    L8,             //< 8 bit luminance
+    I1,             //< 1 bit palette index, MSB first
+    I2,             //< 2 bit palette index, MSB first
+    I4,             //< 4 bit palette index, MSB first
+    I8,             //< 8 bit palette index
+  };
+
+  struct Image {
+    Format format{Format::RGB565};
+    int width{0};
+    int height{0};
+    size_t stride{0};                //< Bytes per row, 0 if the rows are packed
+    const uint8_t *pixels{nullptr};  //< The first row of pixels
+    const uint8_t *palette{nullptr}; //< Indexed formats only: B, G, R, A per entry
+  };
+
+  /// @brief Returns the number of bytes in a packed row of pixels.
+  static size_t packed_stride(Format format, int width);
+
+  /// @brief Computes the brightness map of an image.
+  /// Each cell is the average brightness (0-255) of the pixels it covers; a
+  /// cell which covers no pixel (the image is smaller than the grid) is 0.
+  /// @param image The image to downsample.
+  /// @param cols The number of columns of the grid.
+  /// @param rows The number of rows of the grid.
+  /// @param brightness_map Output, cols x rows values, row-major.
+  /// @return False if the image can't be read, the map is then all 0.
+  bool compute(const Image &image, int cols, int rows, uint8_t *brightness_map);
+
+  /// @brief Brightness of an RGB color, the same luma weights as LVGL.
+  static constexpr uint8_t luma(uint32_t r, uint32_t g, uint32_t b) {
+    return (r * 77 + g * 151 + b * 28) >> 8;
+  }
+
+protected:
+  std::vector<int> x_bounds_;         // first source column of each cell column, and the end
+  std::vector<int> y_bounds_;         // first source row of each cell row, and the end
+  std::vector<uint8_t> line_;         // brightness of each pixel of a source row
+  std::vector<uint32_t> column_sums_; // brightness of each source column in a cell row
+
+  /// Turns `width` pixels starting at `src` into one brightness per pixel.
+  typedef void (*row_kernel)(const uint8_t *src, int width, const uint8_t *palette_luma,
+                             uint8_t *luma);
+
+  static row_kernel select_kernel(Format format);
+
+  static void rgb565_row(const uint8_t *src, int width, const uint8_t *, uint8_t *luma);
+  static void rgb565_swapped_row(const uint8_t *src, int width, const uint8_t *, uint8_t *luma);
+  static void rgb888_row(const uint8_t *src, int width, const uint8_t *, uint8_t *luma);
+  static void argb8888_row(const uint8_t *src, int width, const uint8_t *, uint8_t *luma);
+  static void xrgb8888_row(const uint8_t *src, int width, const uint8_t *, uint8_t *luma);
+  static void l8_row(const uint8_t *src, int width, const uint8_t *, uint8_t *luma);
+  template <int bpp>
+  static void indexed_row(const uint8_t *src, int width, const uint8_t *palette_luma,
+                          uint8_t *luma);
+};
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+/// @brief Streams an animated image for the rain's reveal from a sequence of
+///        brightness maps (a .bmseq file, written by the host asset compiler).
+/// Only two frames are ever in memory: the front frame, which the rain shows,
+/// and the back frame, which is read from the file while the front one is
+/// shown. The two sides may run in different tasks: read_next() is the only
+/// call which touches the file, and advance() only swaps the buffers, so the
+/// rain never waits for the file system. advance() fails when the next frame
+/// isn't read yet, and the rain then keeps the current frame a bit longer.
+///
+/// A .bmseq file is a header followed by num_frames frames of cols x rows
+/// brightness values each:
+///   magic[4] ("MRBS"), version, reserved, cols (u16), rows (u16),
+///   num_frames (u16), frame_interval_ms (u16)
+/// with every field in little endian order.
+class BrightnessSequence {
+public:
+  struct Header {
+    uint16_t cols{0};
+    uint16_t rows{0};
+    uint16_t num_frames{0};
+    uint16_t frame_interval_ms{100}; //< Time each frame is shown
+  };
+
+  /// @brief Opens a sequence and reads its first frame into the front buffer.
+  /// @param file The .bmseq file.
+  /// @return False if the file can't be read or is not a sequence.
+  bool open(const std::filesystem::path &file);
+  /// @brief Closes the file and frees the frames.
+  void close();
+  bool is_open() const { return stream_.is_open(); }
+  const Header &header() const { return header_; }
+  /// @brief Size of one frame in bytes, cols x rows.
+  size_t frame_size() const { return (size_t)header_.cols * header_.rows; }
+
+  /// @brief The frame to show, cols x rows values, row-major.
+  const uint8_t *front() const { return frames_[front_].data(); }
+  /// @brief Makes the frame read by read_next() the front frame.
+  /// @return False if the next frame isn't read yet, front() is unchanged.
+  bool advance();
+
+  /// @brief Returns true if the back buffer is free for read_next().
+  bool needs_frame() const { return !back_ready_.load(std::memory_order_acquire); }
+  /// @brief Reads the next frame of the file into the back buffer, wrapping
+  ///        around to the first frame after the last one.
+  /// Does nothing while the previous frame hasn't been taken by advance().
+  /// @return False if the frame couldn't be read.
+  bool read_next();
+
+  /// @brief Writes a sequence file.
+  /// @param file The .bmseq file.
+  /// @param header cols, rows, num_frames and frame_interval_ms of the sequence.
+  /// @param frames num_frames x cols x rows values.
+  /// @return True if the file was written.
+  static bool write(const std::filesystem::path &file, const Header &header,
+                    const std::vector<uint8_t> &frames);
+
+protected:
+  static constexpr char magic[4] = {'M', 'R', 'B', 'S'};
+  static constexpr uint8_t version = 1;
+  static constexpr size_t header_size = 4 + 1 + 1 + 2 + 2 + 2 + 2;
+
+  Header header_;
+  std::ifstream stream_;
+  int next_frame_{0}; // index in the file of the frame read_next() reads
+  std::vector<uint8_t> frames_[2];
+  int front_{0}; // only changed by advance(), while the back buffer is ready
+  std::atomic<bool> back_ready_{false};
+};
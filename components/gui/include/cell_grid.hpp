@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <lvgl.h>
+#include <vector>
+
+#include "lvgl_private.h" // LV_INV_BUF_SIZE, lv_layer_t::_clip_area
+
+#include "glyph_set.hpp"
+
+/// @brief LVGL widget which draws a grid of glyphs with fixed cell metrics.
+/// The grid owns one RainEngine render key per cell (glyph and color) and
+/// draws the cells which intersect the area LVGL is redrawing, one glyph per
+/// cell, so nothing is laid out as text. When the keys change, only the cells
+/// which changed are invalidated, so only those are redrawn and flushed.
+/// update_row() doesn't call LVGL, so rows can be updated from several tasks
+/// at the same time; everything else must run in the LVGL task.
+class CellGrid {
+public:
+  struct Config {
+    int cols = 16;        //< Number of columns
+    int rows = 9;         //< Number of rows
+    int cell_width = 8;   //< Width of a cell in pixels
+    int cell_height = 15; //< Height of a cell in pixels, usually the font's line height
+    const lv_font_t *font = nullptr; //< Font of the glyphs, the parent's font if not set
+    const GlyphSet *glyph_set = &katakana_glyph_set; //< Glyphs the keys can show
+  };
+
+  explicit CellGrid(const Config &config);
+  ~CellGrid();
+
+  /// @brief Creates the widget, with all cells blank, at the top left of the
+  ///        parent.
+  void init(lv_obj_t *parent);
+  /// @brief Deletes the widget.
+  void deinit();
+  /// @brief Returns the widget, nullptr before init().
+  lv_obj_t *get_obj() const { return obj_; }
+  /// @brief Sets the font of the glyphs and redraws every cell.
+  void set_font(const lv_font_t *font);
+
+  /// @brief Sets the keys of a row, and marks the cells which changed.
+  /// @param y The row.
+  /// @param row_keys The cols render keys of the row, 0 for a blank cell.
+  /// @return True if any cell of the row changed.
+  bool update_row(int y, const uint32_t *row_keys);
+  /// @brief Invalidates the cells marked by update_row() since the last call.
+  void invalidate_changed();
+
+protected:
+  /// Areas invalidated by one invalidate_changed() at most. LVGL refreshes
+  /// the whole screen once its buffer of areas is full, so with more changes
+  /// than this the changes of each row are invalidated as one area.
+  static constexpr int max_areas = LV_INV_BUF_SIZE / 2;
+
+  Config config_;
+  lv_obj_t *obj_{nullptr};
+  std::vector<uint32_t> keys_;    // render key of each cell, row-major
+  std::vector<uint8_t> changed_;  // cells changed since the last invalidate, row-major
+  std::vector<uint8_t> row_changed_; // rows with a changed cell
+
+  void invalidate_cells(int y, int x1, int x2);
+  void draw(lv_layer_t *layer);
+  static void draw_event_cb(lv_event_t *e);
+};
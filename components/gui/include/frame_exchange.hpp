@@ -0,0 +1,52 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+/// @brief Lock-free hand-off of frames from one producer thread to one
+///        consumer thread.
+/// The producer fills back() and publish()es it; the consumer acquire()s the
+/// newest published frame and reads it through front(). A third, spare
+/// buffer sits between the two, so publishing and acquiring are a single
+/// atomic exchange each and neither side ever waits for the other: the
+/// producer may publish frames faster than they are consumed (the consumer
+/// just skips to the newest), and the consumer may hold on to front() for as
+/// long as it needs to draw it.
+template <typename Frame> class FrameExchange {
+public:
+  /// @brief Returns one of the three buffers, for initializing them all
+  ///        before the threads start.
+  Frame &buffer(int index) { return buffers_[index]; }
+
+  /// @brief The buffer the producer is filling.
+  Frame &back() { return buffers_[back_]; }
+
+  /// @brief Publishes back() as the newest frame and starts a new back().
+  /// Only the producer may call this.
+  void publish() {
+    back_ = spare_.exchange(back_ | fresh_bit, std::memory_order_acq_rel) & index_mask;
+  }
+
+  /// @brief Takes the newest published frame, if there is one which the
+  ///        consumer hasn't seen yet. Only the consumer may call this.
+  /// @return True if front() is now a new frame.
+  bool acquire() {
+    if (!(spare_.load(std::memory_order_relaxed) & fresh_bit))
+      return false;
+    front_ = spare_.exchange(front_, std::memory_order_acq_rel) & index_mask;
+    return true;
+  }
+
+  /// @brief The frame the consumer acquired last.
+  const Frame &front() const { return buffers_[front_]; }
+
+protected:
+  static constexpr uint8_t index_mask = 0x3;
+  static constexpr uint8_t fresh_bit = 0x4; //< The spare buffer holds an unseen frame
+
+  std::array<Frame, 3> buffers_;
+  uint8_t back_{0};                // only touched by the producer
+  uint8_t front_{1};               // only touched by the consumer
+  std::atomic<uint8_t> spare_{2};  // index of the spare buffer, plus fresh_bit
+};
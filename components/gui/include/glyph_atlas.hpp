@@ -0,0 +1,80 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "rain_engine.hpp"
+
+/// @brief Every rain glyph pre-rasterized into RGB565 cell tiles, in every
+///        color a cell can have, so drawing a cell is just copying a tile.
+/// There is a tile for the head color, the body color and num_levels fade
+/// levels of each glyph; fading cells use the tile of the nearest level. The
+/// tiles are as large as a cell and include its black background. Small
+/// atlases live in internal RAM, larger ones in PSRAM (or internal RAM if
+/// there is no PSRAM).
+class GlyphAtlas {
+public:
+  /// A 1bpp glyph bitmap of a font, placed in its cell.
+  struct Glyph {
+    const uint8_t *bitmap{nullptr}; //< 1bpp bitmap, rows packed without padding
+    uint8_t width{0};
+    uint8_t height{0};
+    int8_t x{0}; //< Offset of the bitmap from the left edge of the cell
+    int8_t y{0}; //< Offset of the bitmap from the top edge of the cell
+  };
+
+  struct Config {
+    int cell_width = 8;    //< Width of a cell (and a tile) in pixels
+    int cell_height = 15;  //< Height of a cell (and a tile) in pixels
+    int num_levels = 16;   //< Fade levels, usually RainEngine::Params::fade_levels
+    const GlyphSet *glyph_set = &katakana_glyph_set; //< Glyphs of the rain
+    size_t internal_max_bytes = 32 * 1024; //< Larger atlases only go to PSRAM
+  };
+
+  explicit GlyphAtlas(const Config &config);
+  ~GlyphAtlas();
+
+  /// @brief Rasterizes the tiles of the rain glyphs.
+  /// @param glyphs A glyph for each glyph of the glyph set, in the set's
+  ///        order. A glyph without a bitmap is blank.
+  /// @return False if the atlas can't be allocated.
+  bool build(const Glyph *glyphs);
+
+  /// @brief Returns the tile which shows a cell, cell_width x cell_height
+  ///        pixels with rows packed, or nullptr for a blank cell.
+  const uint16_t *tile(uint32_t key) const {
+    if (!key || !tiles_)
+      return nullptr;
+    int color;
+    switch (RainEngine::key_kind(key)) {
+    case RainEngine::KEY_HEAD:
+      color = 0;
+      break;
+    case RainEngine::KEY_BODY:
+      color = 1;
+      break;
+    default:
+      color = fade_colors_[RainEngine::key_level(key)];
+      break;
+    }
+    return &tiles_[(RainEngine::key_glyph(key) * num_colors_ + color) * tile_size_];
+  }
+
+  /// @brief Returns the size of the tiles in bytes, 0 before build().
+  size_t size_bytes() const { return tiles_ ? num_bytes_ : 0; }
+  /// @brief Returns true if the tiles are in PSRAM.
+  bool in_psram() const { return in_psram_; }
+
+protected:
+  Config config_;
+  int num_colors_{0};   // head, body and the fade levels
+  size_t tile_size_{0}; // pixels per tile
+  size_t num_bytes_{0};
+  uint16_t *tiles_{nullptr}; // glyph-major, then color, then pixels
+  bool in_psram_{false};
+  std::array<uint8_t, 256> fade_colors_{}; // green level of a fading key -> color
+
+  void free_tiles();
+  void draw_tile(uint16_t *tile, const Glyph &glyph, uint16_t color) const;
+};
@@ -0,0 +1,199 @@
+#pragma once
+
+// Generated by host/glyph_ink.cpp from components/gui/src/UNSCII_8_JP.c, do
+// not edit. The host build checks that it is up to date.
+
+#include <array>
+#include <cstdint>
+
+/// Codepoints of every glyph of unscii_8_jp, in ascending order.
+inline constexpr std::array<uint32_t, 1470> font_codepoints = {
+    0x0304, 0x0307, 0x030C, 0x0391, 0x0392, 0x0393, 0x0394, 0x0395, 0x0396, 0x0397, 0x0398, 0x0399, 0x039A, 0x039B, 0x039C, 0x039D,
+    0x039E, 0x039F, 0x03A0, 0x03A1, 0x03A3, 0x03A4, 0x03A5, 0x03A6, 0x03A7, 0x03A8, 0x03A9, 0x03B1, 0x03B2, 0x03B3, 0x03B4, 0x03B5,
+    0x03B6, 0x03B7, 0x03B8, 0x03B9, 0x03BA, 0x03BB, 0x03BC, 0x03BD, 0x03BE, 0x03BF, 0x03C0, 0x03C1, 0x03C2, 0x03C3, 0x03C4, 0x03C5,
+    0x03C6, 0x03C7, 0x03C8, 0x03C9, 0x0401, 0x0410, 0x0411, 0x0412, 0x0413, 0x0414, 0x0415, 0x0416, 0x0417, 0x0418, 0x0419, 0x041A,
+    0x041B, 0x041C, 0x041D, 0x041E, 0x041F, 0x0420, 0x0421, 0x0422, 0x0423, 0x0424, 0x0425, 0x0426, 0x0427, 0x0428, 0x0429, 0x042A,
+    0x042B, 0x042C, 0x042D, 0x042E, 0x042F, 0x0430, 0x0431, 0x0432, 0x0433, 0x0434, 0x0435, 0x0436, 0x0437, 0x0438, 0x0439, 0x043A,
+    0x043B, 0x043C, 0x043D, 0x043E, 0x043F, 0x0440, 0x0441, 0x0442, 0x0443, 0x0444, 0x0445, 0x0446, 0x0447, 0x0448, 0x0449, 0x044A,
+    0x044B, 0x044C, 0x044D, 0x044E, 0x044F, 0x0451, 0x1E3E, 0x1E3F, 0x1EA0, 0x1EA1, 0x1EA2, 0x1EA3, 0x1EA4, 0x1EA5, 0x1EA6, 0x1EA7,
+    0x1EA8, 0x1EA9, 0x1EAA, 0x1EAB, 0x1EAC, 0x1EAD, 0x1EAE, 0x1EAF, 0x1EB0, 0x1EB1, 0x1EB2, 0x1EB3, 0x1EB4, 0x1EB5, 0x1EB6, 0x1EB7,
+    0x1EB8, 0x1EB9, 0x1EBA, 0x1EBB, 0x1EBC, 0x1EBD, 0x1EBE, 0x1EBF, 0x1EC0, 0x1EC1, 0x1EC2, 0x1EC3, 0x1EC4, 0x1EC5, 0x1EC6, 0x1EC7,
+    0x1EC8, 0x1EC9, 0x1ECA, 0x1ECB, 0x1ECC, 0x1ECD, 0x1ECE, 0x1ECF, 0x1ED0, 0x1ED1, 0x1ED2, 0x1ED3, 0x1ED4, 0x1ED5, 0x1ED6, 0x1ED7,
+    0x1ED8, 0x1ED9, 0x1EDA, 0x1EDB, 0x1EDC, 0x1EDD, 0x1EDE, 0x1EDF, 0x1EE0, 0x1EE1, 0x1EE2, 0x1EE3, 0x1EE4, 0x1EE5, 0x1EE6, 0x1EE7,
+    0x1EE8, 0x1EE9, 0x1EEA, 0x1EEB, 0x1EEC, 0x1EED, 0x1EEE, 0x1EEF, 0x1EF0, 0x1EF1, 0x1EF2, 0x1EF3, 0x1EF4, 0x1EF5, 0x1EF6, 0x1EF7,
+    0x1EF8, 0x1EF9, 0x2002, 0x2003, 0x2010, 0x2011, 0x2012, 0x2013, 0x2014, 0x2015, 0x2016, 0x2018, 0x2019, 0x201A, 0x201C, 0x201D,
+    0x201E, 0x2020, 0x2021, 0x2022, 0x2025, 0x2026, 0x2027, 0x2030, 0x2032, 0x2033, 0x2035, 0x2039, 0x203A, 0x203B, 0x203C, 0x2042,
+    0x2047, 0x2048, 0x2049, 0x2051, 0x2074, 0x20A9, 0x20AB, 0x20AC, 0x20DD, 0x20DE, 0x2100, 0x2103, 0x2105, 0x2109, 0x210A, 0x210F,
+    0x2113, 0x2116, 0x2121, 0x2122, 0x2126, 0x2127, 0x212B, 0x212E, 0x2135, 0x213B, 0x2160, 0x2161, 0x2162, 0x2163, 0x2164, 0x2165,
+    0x2166, 0x2167, 0x2168, 0x2169, 0x216A, 0x216B, 0x2170, 0x2171, 0x2172, 0x2173, 0x2174, 0x2175, 0x2176, 0x2177, 0x2178, 0x2179,
+    0x217A, 0x217B, 0x2190, 0x2191, 0x2192, 0x2193, 0x2194, 0x2195, 0x2196, 0x2197, 0x2198, 0x2199, 0x21B8, 0x21B9, 0x21C4, 0x21C5,
+    0x21C6, 0x21CB, 0x21CC, 0x21D0, 0x21D2, 0x21D4, 0x21E6, 0x21E7, 0x21E8, 0x21E9, 0x21F5, 0x2200, 0x2202, 0x2203, 0x2205, 0x2206,
+    0x2207, 0x2208, 0x2209, 0x220A, 0x220B, 0x220F, 0x2211, 0x2212, 0x2213, 0x2215, 0x221A, 0x221D, 0x221E, 0x221F, 0x2220, 0x2223,
+    0x2225, 0x2226, 0x2227, 0x2228, 0x2229, 0x222A, 0x222B, 0x222C, 0x222D, 0x222E, 0x2234, 0x2235, 0x2236, 0x2237, 0x223D, 0x2243,
+    0x2245, 0x2248, 0x224C, 0x2260, 0x2261, 0x2262, 0x2264, 0x2265, 0x2266, 0x2267, 0x226A, 0x226B, 0x226E, 0x226F, 0x2272, 0x2273,
+    0x2276, 0x2277, 0x2282, 0x2283, 0x2284, 0x2285, 0x2286, 0x2287, 0x228A, 0x228B, 0x2295, 0x2296, 0x2297, 0x2298, 0x2299, 0x22A0,
+    0x22A5, 0x22BF, 0x22DA, 0x22DB, 0x22EF, 0x2305, 0x2306, 0x2307, 0x2312, 0x2318, 0x2329, 0x232A, 0x23B0, 0x23B1, 0x23BE, 0x23BF,
+    0x23C0, 0x23C1, 0x23C2, 0x23C3, 0x23C4, 0x23C5, 0x23C6, 0x23C7, 0x23C8, 0x23C9, 0x23CA, 0x23CB, 0x23CC, 0x23CE, 0x23DA, 0x23DB,
+    0x2423, 0x2460, 0x2461, 0x2462, 0x2463, 0x2464, 0x2465, 0x2466, 0x2467, 0x2468, 0x2469, 0x246A, 0x246B, 0x246C, 0x246D, 0x246E,
+    0x246F, 0x2470, 0x2471, 0x2472, 0x2473, 0x2474, 0x2475, 0x2476, 0x2477, 0x2478, 0x2479, 0x247A, 0x247B, 0x247C, 0x247D, 0x247E,
+    0x247F, 0x2480, 0x2481, 0x2482, 0x2483, 0x2484, 0x2485, 0x2486, 0x2487, 0x2488, 0x2489, 0x248A, 0x248B, 0x248C, 0x248D, 0x248E,
+    0x248F, 0x2490, 0x2491, 0x2492, 0x2493, 0x2494, 0x2495, 0x2496, 0x2497, 0x2498, 0x2499, 0x249A, 0x249B, 0x249C, 0x249D, 0x249E,
+    0x249F, 0x24A0, 0x24A1, 0x24A2, 0x24A3, 0x24A4, 0x24A5, 0x24A6, 0x24A7, 0x24A8, 0x24A9, 0x24AA, 0x24AB, 0x24AC, 0x24AD, 0x24AE,
+    0x24AF, 0x24B0, 0x24B1, 0x24B2, 0x24B3, 0x24B4, 0x24B5, 0x24B6, 0x24B7, 0x24B8, 0x24B9, 0x24BA, 0x24BB, 0x24BC, 0x24BD, 0x24BE,
+    0x24BF, 0x24C0, 0x24C1, 0x24C2, 0x24C3, 0x24C4, 0x24C5, 0x24C6, 0x24C7, 0x24C8, 0x24C9, 0x24CA, 0x24CB, 0x24CC, 0x24CD, 0x24CE,
+    0x24CF, 0x24D0, 0x24D1, 0x24D2, 0x24D3, 0x24D4, 0x24D5, 0x24D6, 0x24D7, 0x24D8, 0x24D9, 0x24DA, 0x24DB, 0x24DC, 0x24DD, 0x24DE,
+    0x24DF, 0x24E0, 0x24E1, 0x24E2, 0x24E3, 0x24E4, 0x24E5, 0x24E6, 0x24E7, 0x24E8, 0x24E9, 0x24EA, 0x24EB, 0x24EC, 0x24ED, 0x24EE,
+    0x24EF, 0x24F0, 0x24F1, 0x24F2, 0x24F3, 0x24F4, 0x24F5, 0x24F6, 0x24F7, 0x24F8, 0x24F9, 0x24FA, 0x24FB, 0x24FC, 0x24FD, 0x24FE,
+    0x24FF, 0x2500, 0x2501, 0x2502, 0x2503, 0x2504, 0x2505, 0x2506, 0x2507, 0x2508, 0x2509, 0x250A, 0x250B, 0x250C, 0x250D, 0x250E,
+    0x250F, 0x2510, 0x2511, 0x2512, 0x2513, 0x2514, 0x2515, 0x2516, 0x2517, 0x2518, 0x2519, 0x251A, 0x251B, 0x251C, 0x251D, 0x251E,
+    0x251F, 0x2520, 0x2521, 0x2522, 0x2523, 0x2524, 0x2525, 0x2526, 0x2527, 0x2528, 0x2529, 0x252A, 0x252B, 0x252C, 0x252D, 0x252E,
+    0x252F, 0x2530, 0x2531, 0x2532, 0x2533, 0x2534, 0x2535, 0x2536, 0x2537, 0x2538, 0x2539, 0x253A, 0x253B, 0x253C, 0x253D, 0x253E,
+    0x253F, 0x2540, 0x2541, 0x2542, 0x2543, 0x2544, 0x2545, 0x2546, 0x2547, 0x2548, 0x2549, 0x254A, 0x254B, 0x254C, 0x254D, 0x254E,
+    0x254F, 0x2550, 0x2551, 0x2552, 0x2553, 0x2554, 0x2555, 0x2556, 0x2557, 0x2558, 0x2559, 0x255A, 0x255B, 0x255C, 0x255D, 0x255E,
+    0x255F, 0x2560, 0x2561, 0x2562, 0x2563, 0x2564, 0x2565, 0x2566, 0x2567, 0x2568, 0x2569, 0x256A, 0x256B, 0x256C, 0x256D, 0x256E,
+    0x256F, 0x2570, 0x2571, 0x2572, 0x2573, 0x2574, 0x2575, 0x2576, 0x2577, 0x2578, 0x2579, 0x257A, 0x257B, 0x257C, 0x257D, 0x257E,
+    0x257F, 0x2580, 0x2581, 0x2582, 0x2583, 0x2584, 0x2585, 0x2586, 0x2587, 0x2588, 0x2589, 0x258A, 0x258B, 0x258C, 0x258D, 0x258E,
+    0x258F, 0x2590, 0x2591, 0x2592, 0x2593, 0x2594, 0x2595, 0x2596, 0x2597, 0x2598, 0x2599, 0x259A, 0x259B, 0x259C, 0x259D, 0x259E,
+    0x259F, 0x25A0, 0x25A1, 0x25A2, 0x25A3, 0x25A4, 0x25A5, 0x25A6, 0x25A7, 0x25A8, 0x25A9, 0x25AA, 0x25AB, 0x25B1, 0x25B2, 0x25B3,
+    0x25B6, 0x25B7, 0x25BC, 0x25BD, 0x25C0, 0x25C1, 0x25C6, 0x25C7, 0x25C9, 0x25CA, 0x25CB, 0x25CC, 0x25CE, 0x25CF, 0x25D0, 0x25D1,
+    0x25D2, 0x25D3, 0x25E2, 0x25E3, 0x25E4, 0x25E5, 0x25E6, 0x25EF, 0x2600, 0x2601, 0x2602, 0x2603, 0x2605, 0x2606, 0x2609, 0x260E,
+    0x260F, 0x2616, 0x2617, 0x261C, 0x261D, 0x261E, 0x261F, 0x262F, 0x2640, 0x2641, 0x2642, 0x2660, 0x2661, 0x2662, 0x2663, 0x2664,
+    0x2665, 0x2666, 0x2667, 0x2668, 0x2669, 0x266A, 0x266B, 0x266C, 0x266D, 0x266E, 0x266F, 0x2672, 0x2673, 0x2674, 0x2675, 0x2676,
+    0x2677, 0x2678, 0x2679, 0x267A, 0x267B, 0x267C, 0x267D, 0x26A0, 0x26BD, 0x26BE, 0x2702, 0x2713, 0x271A, 0x273D, 0x273F, 0x2740,
+    0x2756, 0x2776, 0x2777, 0x2778, 0x2779, 0x277A, 0x277B, 0x277C, 0x277D, 0x277E, 0x277F, 0x2780, 0x2781, 0x2782, 0x2783, 0x2784,
+    0x2785, 0x2786, 0x2787, 0x2788, 0x2789, 0x278A, 0x278B, 0x278C, 0x278D, 0x278E, 0x278F, 0x2790, 0x2791, 0x2792, 0x2793, 0x27A1,
+    0x2934, 0x2935, 0x29BF, 0x29FA, 0x29FB, 0x2B05, 0x2B06, 0x2B07, 0x2B1A, 0x2B95, 0x2E3A, 0x2E3B, 0x2E80, 0x2E81, 0x2E82, 0x2E83,
+    0x2E84, 0x2E85, 0x2E86, 0x2E87, 0x2E88, 0x2E89, 0x2E8A, 0x2E8B, 0x2E8C, 0x2E8D, 0x2E8E, 0x2E8F, 0x2E90, 0x2E91, 0x2E92, 0x2E93,
+    0x2E94, 0x2E95, 0x2E96, 0x2E97, 0x2E98, 0x2E99, 0x2E9B, 0x2E9C, 0x2E9D, 0x2E9E, 0x2E9F, 0x2EA0, 0x2EA1, 0x2EA2, 0x2EA3, 0x2EA4,
+    0x2EA5, 0x2EA6, 0x2EA7, 0x2EA8, 0x2EA9, 0x2EAA, 0x2EAB, 0x2EAC, 0x2EAD, 0x2EAE, 0x2EAF, 0x2EB0, 0x2EB1, 0x2EB2, 0x2EB3, 0x2EB4,
+    0x2EB5, 0x2EB6, 0x2EB7, 0x2EB8, 0x2EB9, 0x2EBA, 0x2EBB, 0x2EBC, 0x2EBD, 0x2EBE, 0x2EBF, 0x2EC0, 0x2EC1, 0x2EC2, 0x2EC3, 0x2EC4,
+    0x2EC5, 0x2EC6, 0x2EC7, 0x2EC8, 0x2EC9, 0x2ECA, 0x2ECB, 0x2ECC, 0x2ECD, 0x2ECE, 0x2ECF, 0x2ED0, 0x2ED1, 0x2ED2, 0x2ED3, 0x2ED4,
+    0x2ED5, 0x2ED6, 0x2ED7, 0x2ED8, 0x2ED9, 0x2EDA, 0x2EDB, 0x2EDC, 0x2EDD, 0x2EDE, 0x2EDF, 0x2EE0, 0x2EE1, 0x2EE2, 0x2EE3, 0x2EE4,
+    0x2EE5, 0x2EE6, 0x2EE7, 0x2EE8, 0x2EE9, 0x2EEA, 0x2EEB, 0x2EEC, 0x2EED, 0x2EEE, 0x2EEF, 0x2EF0, 0x2EF1, 0x2EF2, 0x2EF3, 0x2F00,
+    0x2F01, 0x2F02, 0x2F03, 0x2F04, 0x2F05, 0x2F06, 0x2F07, 0x2F08, 0x2F09, 0x2F0A, 0x2F0B, 0x2F0C, 0x2F0D, 0x2F0E, 0x2F0F, 0x2F10,
+    0x2F11, 0x2F12, 0x2F13, 0x2F14, 0x2F15, 0x2F16, 0x2F17, 0x2F18, 0x2F19, 0x2F1A, 0x2F1B, 0x2F1C, 0x2F1D, 0x2F1E, 0x2F1F, 0x2F20,
+    0x2F21, 0x2F22, 0x2F23, 0x2F24, 0x2F25, 0x2F26, 0x2F27, 0x2F28, 0x2F29, 0x2F2A, 0x2F2B, 0x2F2C, 0x2F2D, 0x2F2E, 0x2F2F, 0x2F30,
+    0x2F31, 0x2F32, 0x2F33, 0x2F34, 0x2F35, 0x2F36, 0x2F37, 0x2F38, 0x2F39, 0x2F3A, 0x2F3B, 0x2F3C, 0x2F3D, 0x2F3E, 0x2F3F, 0x2F40,
+    0x2F41, 0x2F42, 0x2F43, 0x2F44, 0x2F45, 0x2F46, 0x2F47, 0x2F48, 0x2F49, 0x2F4A, 0x2F4B, 0x2F4C, 0x2F4D, 0x2F4E, 0x2F4F, 0x2F50,
+    0x2F51, 0x2F52, 0x2F53, 0x2F54, 0x2F55, 0x2F56, 0x2F57, 0x2F58, 0x2F59, 0x2F5A, 0x2F5B, 0x2F5C, 0x2F5D, 0x2F5E, 0x2F5F, 0x2F60,
+    0x2F61, 0x2F62, 0x2F63, 0x2F64, 0x2F65, 0x2F66, 0x2F67, 0x2F68, 0x2F69, 0x2F6A, 0x2F6B, 0x2F6C, 0x2F6D, 0x2F6E, 0x2F6F, 0x2F70,
+    0x2F71, 0x2F72, 0x2F73, 0x2F74, 0x2F75, 0x2F76, 0x2F77, 0x2F78, 0x2F79, 0x2F7A, 0x2F7B, 0x2F7C, 0x2F7D, 0x2F7E, 0x2F7F, 0x2F80,
+    0x2F81, 0x2F82, 0x2F83, 0x2F84, 0x2F85, 0x2F86, 0x2F87, 0x2F88, 0x2F89, 0x2F8A, 0x2F8B, 0x2F8C, 0x2F8D, 0x2F8E, 0x2F8F, 0x2F90,
+    0x2F91, 0x2F92, 0x2F93, 0x2F94, 0x2F95, 0x2F96, 0x2F97, 0x2F98, 0x2F99, 0x2F9A, 0x2F9B, 0x2F9C, 0x2F9D, 0x2F9E, 0x2F9F, 0x2FA0,
+    0x2FA1, 0x2FA2, 0x2FA3, 0x2FA4, 0x2FA5, 0x2FA6, 0x2FA7, 0x2FA8, 0x2FA9, 0x2FAA, 0x2FAB, 0x2FAC, 0x2FAD, 0x2FAE, 0x2FAF, 0x2FB0,
+    0x2FB1, 0x2FB2, 0x2FB3, 0x2FB4, 0x2FB5, 0x2FB6, 0x2FB7, 0x2FB8, 0x2FB9, 0x2FBA, 0x2FBB, 0x2FBC, 0x2FBD, 0x2FBE, 0x2FBF, 0x2FC0,
+    0x2FC1, 0x2FC2, 0x2FC3, 0x2FC4, 0x2FC5, 0x2FC6, 0x2FC7, 0x2FC8, 0x2FC9, 0x2FCA, 0x2FCB, 0x2FCC, 0x2FCD, 0x2FCE, 0x2FCF, 0x2FD0,
+    0x2FD1, 0x2FD2, 0x2FD3, 0x2FD4, 0x2FD5, 0x2FF0, 0x2FF1, 0x2FF2, 0x2FF3, 0x2FF4, 0x2FF5, 0x2FF6, 0x2FF7, 0x2FF8, 0x2FF9, 0x2FFA,
+    0x2FFB, 0x3000, 0x3001, 0x3002, 0x3003, 0x3004, 0x3005, 0x3006, 0x3007, 0x3008, 0x3009, 0x300A, 0x300B, 0x300C, 0x300D, 0x300E,
+    0x300F, 0x3010, 0x3011, 0x3012, 0x3013, 0x3014, 0x3015, 0x3016, 0x3017, 0x3018, 0x3019, 0x301A, 0x301B, 0x301C, 0x301D, 0x301E,
+    0x301F, 0x3020, 0x3021, 0x3022, 0x3023, 0x3024, 0x3025, 0x3026, 0x3027, 0x3028, 0x3029, 0x302A, 0x302B, 0x302C, 0x302D, 0x302E,
+    0x302F, 0x3030, 0x3031, 0x3032, 0x3033, 0x3034, 0x3035, 0x3036, 0x3037, 0x3038, 0x3039, 0x303A, 0x303B, 0x303C, 0x303D, 0x303E,
+    0x303F, 0x3041, 0x3042, 0x3043, 0x3044, 0x3045, 0x3046, 0x3047, 0x3048, 0x3049, 0x304A, 0x304B, 0x304C, 0x304D, 0x304E, 0x304F,
+    0x3050, 0x3051, 0x3052, 0x3053, 0x3054, 0x3055, 0x3056, 0x3057, 0x3058, 0x3059, 0x305A, 0x305B, 0x305C, 0x305D, 0x305E, 0x305F,
+    0x3060, 0x3061, 0x3062, 0x3063, 0x3064, 0x3065, 0x3066, 0x3067, 0x3068, 0x3069, 0x306A, 0x306B, 0x306C, 0x306D, 0x306E, 0x306F,
+    0x3070, 0x3071, 0x3072, 0x3073, 0x3074, 0x3075, 0x3076, 0x3077, 0x3078, 0x3079, 0x307A, 0x307B, 0x307C, 0x307D, 0x307E, 0x307F,
+    0x3080, 0x3081, 0x3082, 0x3083, 0x3084, 0x3085, 0x3086, 0x3087, 0x3088, 0x3089, 0x308A, 0x308B, 0x308C, 0x308D, 0x308E, 0x308F,
+    0x3090, 0x3091, 0x3092, 0x3093, 0x3094, 0x3095, 0x3096, 0x3099, 0x309A, 0x309B, 0x309C, 0x309D, 0x309E, 0x309F, 0x30A0, 0x30A1,
+    0x30A2, 0x30A3, 0x30A4, 0x30A5, 0x30A6, 0x30A7, 0x30A8, 0x30A9, 0x30AA, 0x30AB, 0x30AC, 0x30AD, 0x30AE, 0x30AF, 0x30B0, 0x30B1,
+    0x30B2, 0x30B3, 0x30B4, 0x30B5, 0x30B6, 0x30B7, 0x30B8, 0x30B9, 0x30BA, 0x30BB, 0x30BC, 0x30BD, 0x30BE, 0x30BF, 0x30C0, 0x30C1,
+    0x30C2, 0x30C3, 0x30C4, 0x30C5, 0x30C6, 0x30C7, 0x30C8, 0x30C9, 0x30CA, 0x30CB, 0x30CC, 0x30CD, 0x30CE, 0x30CF, 0x30D0, 0x30D1,
+    0x30D2, 0x30D3, 0x30D4, 0x30D5, 0x30D6, 0x30D7, 0x30D8, 0x30D9, 0x30DA, 0x30DB, 0x30DC, 0x30DD, 0x30DE, 0x30DF, 0x30E0, 0x30E1,
+    0x30E2, 0x30E3, 0x30E4, 0x30E5, 0x30E6, 0x30E7, 0x30E8, 0x30E9, 0x30EA, 0x30EB, 0x30EC, 0x30ED, 0x30EE, 0x30EF, 0x30F0, 0x30F1,
+    0x30F2, 0x30F3, 0x30F4, 0x30F5, 0x30F6, 0x30F7, 0x30F8, 0x30F9, 0x30FA, 0x30FB, 0x30FC, 0x30FD, 0x30FE, 0x30FF,
+};
+
+/// Number of lit pixels in the bitmap of each glyph of font_codepoints.
+inline constexpr std::array<uint8_t, 1470> font_ink = {
+    2, 2, 2, 9, 13, 8, 10, 13, 10, 12, 14, 5, 11, 8, 18, 14,
+    9, 12, 12, 10, 11, 7, 6, 13, 7, 11, 14, 10, 16, 9, 14, 8,
+    9, 9, 14, 4, 9, 11, 10, 6, 11, 10, 10, 9, 7, 11, 8, 9,
+    14, 10, 15, 12, 14, 9, 11, 13, 8, 16, 13, 16, 13, 13, 16, 10,
+    11, 18, 12, 12, 12, 10, 11, 7, 9, 9, 7, 13, 9, 19, 20, 12,
+    15, 10, 13, 18, 13, 9, 14, 10, 6, 11, 11, 11, 9, 10, 12, 8,
+    9, 14, 10, 8, 10, 11, 8, 8, 10, 19, 7, 11, 8, 12, 14, 9,
+    12, 8, 10, 14, 9, 13, 19, 14, 10, 10, 10, 9, 11, 13, 12, 12,
+    11, 13, 13, 11, 12, 11, 12, 11, 12, 10, 11, 11, 13, 12, 12, 11,
+    14, 12, 14, 12, 16, 13, 15, 12, 16, 11, 16, 12, 17, 14, 16, 14,
+    7, 5, 6, 6, 13, 9, 13, 9, 14, 9, 14, 8, 15, 9, 15, 9,
+    14, 12, 15, 11, 15, 11, 15, 11, 16, 13, 15, 11, 12, 11, 11, 11,
+    14, 14, 14, 14, 14, 13, 14, 14, 14, 14, 7, 11, 7, 11, 7, 10,
+    9, 12, 0, 0, 2, 2, 4, 4, 7, 6, 16, 2, 2, 2, 3, 3,
+    3, 8, 11, 2, 0, 2, 0, 20, 2, 4, 2, 3, 3, 17, 8, 19,
+    11, 10, 10, 13, 4, 17, 12, 13, 20, 28, 17, 18, 16, 20, 16, 14,
+    13, 29, 30, 14, 21, 20, 19, 19, 13, 28, 5, 10, 15, 13, 8, 14,
+    19, 22, 15, 9, 15, 18, 4, 10, 14, 12, 7, 11, 15, 19, 13, 7,
+    11, 15, 12, 11, 12, 11, 16, 16, 10, 10, 10, 10, 16, 27, 20, 22,
+    20, 18, 18, 18, 16, 18, 20, 18, 18, 18, 22, 13, 13, 18, 21, 15,
+    15, 20, 17, 8, 20, 23, 16, 4, 12, 8, 10, 16, 16, 11, 11, 6,
+    11, 12, 10, 11, 16, 16, 11, 20, 31, 16, 3, 3, 2, 4, 14, 10,
+    16, 10, 26, 15, 16, 17, 14, 14, 19, 19, 16, 16, 13, 14, 14, 14,
+    19, 19, 16, 16, 19, 19, 18, 18, 17, 19, 26, 23, 19, 21, 19, 29,
+    10, 16, 22, 22, 2, 6, 8, 12, 8, 40, 8, 8, 12, 12, 13, 13,
+    20, 22, 27, 22, 26, 26, 14, 21, 20, 15, 15, 13, 13, 24, 11, 17,
+    9, 26, 30, 31, 30, 30, 32, 26, 34, 31, 41, 32, 37, 41, 32, 33,
+    40, 32, 34, 38, 37, 24, 25, 27, 27, 29, 27, 25, 29, 27, 28, 30,
+    26, 25, 32, 27, 28, 28, 26, 31, 30, 12, 12, 14, 13, 15, 13, 10,
+    16, 14, 14, 13, 17, 18, 18, 18, 20, 16, 17, 19, 20, 26, 29, 21,
+    29, 26, 28, 30, 28, 24, 24, 28, 24, 31, 29, 28, 30, 29, 20, 29,
+    24, 27, 24, 25, 25, 26, 24, 27, 32, 27, 31, 31, 32, 34, 34, 29,
+    29, 33, 30, 38, 38, 30, 30, 32, 34, 31, 32, 34, 30, 33, 30, 30,
+    29, 27, 29, 26, 30, 27, 29, 28, 28, 24, 26, 27, 25, 39, 29, 28,
+    27, 32, 26, 27, 28, 26, 26, 29, 27, 27, 26, 30, 40, 43, 39, 38,
+    37, 37, 43, 32, 37, 37, 38, 39, 40, 43, 38, 39, 39, 41, 40, 42,
+    39, 8, 8, 8, 8, 6, 6, 6, 6, 8, 8, 4, 4, 9, 9, 9,
+    9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 11, 11, 13,
+    11, 11, 13, 12, 11, 11, 11, 11, 13, 11, 12, 13, 11, 11, 11, 13,
+    11, 11, 13, 13, 11, 11, 11, 11, 11, 11, 13, 12, 11, 11, 14, 14,
+    13, 14, 14, 13, 16, 16, 16, 16, 14, 14, 14, 14, 15, 4, 4, 4,
+    4, 16, 16, 13, 13, 18, 13, 13, 20, 13, 13, 16, 13, 13, 18, 11,
+    18, 18, 11, 19, 19, 19, 11, 19, 18, 11, 18, 11, 11, 32, 7, 7,
+    7, 7, 8, 8, 16, 4, 4, 4, 4, 4, 4, 4, 4, 8, 8, 8,
+    8, 32, 8, 16, 24, 32, 40, 48, 56, 64, 56, 48, 40, 32, 24, 16,
+    8, 32, 16, 32, 64, 8, 8, 16, 16, 16, 48, 32, 48, 48, 16, 32,
+    48, 36, 24, 28, 33, 39, 41, 45, 39, 39, 39, 4, 8, 16, 26, 17,
+    24, 18, 24, 17, 24, 19, 24, 14, 32, 14, 20, 12, 38, 44, 36, 36,
+    34, 34, 36, 36, 29, 29, 6, 20, 21, 20, 17, 30, 19, 19, 19, 25,
+    35, 19, 34, 21, 21, 21, 22, 36, 16, 16, 15, 31, 18, 12, 32, 20,
+    28, 20, 23, 21, 10, 14, 18, 22, 14, 15, 12, 33, 19, 19, 21, 23,
+    21, 20, 19, 18, 28, 37, 29, 24, 38, 24, 19, 9, 18, 13, 33, 34,
+    15, 40, 38, 37, 41, 44, 42, 39, 42, 44, 35, 26, 30, 31, 30, 30,
+    32, 26, 34, 31, 41, 40, 38, 37, 41, 44, 42, 39, 42, 44, 35, 16,
+    15, 14, 26, 10, 17, 16, 21, 21, 20, 16, 13, 20, 5, 8, 7, 13,
+    14, 8, 18, 20, 7, 13, 11, 20, 8, 7, 22, 16, 22, 22, 27, 15,
+    19, 22, 9, 7, 15, 20, 25, 16, 23, 20, 33, 29, 12, 17, 7, 7,
+    11, 11, 17, 11, 17, 15, 18, 12, 14, 12, 10, 8, 20, 18, 16, 24,
+    18, 30, 20, 25, 20, 17, 23, 19, 25, 11, 12, 10, 28, 12, 16, 32,
+    25, 29, 25, 8, 22, 19, 27, 12, 11, 14, 16, 14, 34, 31, 26, 20,
+    22, 15, 17, 38, 28, 27, 27, 17, 27, 17, 19, 9, 29, 21, 26, 34,
+    31, 25, 31, 35, 32, 30, 26, 23, 34, 31, 31, 26, 39, 37, 30, 8,
+    7, 3, 7, 17, 8, 14, 9, 13, 16, 13, 14, 22, 8, 7, 20, 18,
+    19, 19, 16, 17, 18, 18, 14, 10, 16, 12, 14, 18, 22, 24, 20, 20,
+    17, 17, 15, 17, 23, 19, 8, 18, 14, 22, 18, 21, 22, 19, 18, 26,
+    22, 19, 15, 14, 15, 21, 16, 23, 21, 13, 13, 17, 20, 24, 24, 24,
+    22, 20, 15, 20, 23, 26, 23, 26, 22, 24, 20, 22, 19, 21, 34, 24,
+    27, 29, 23, 20, 18, 22, 14, 20, 18, 19, 25, 21, 18, 21, 25, 22,
+    29, 26, 27, 34, 30, 24, 12, 12, 26, 27, 30, 28, 30, 22, 26, 21,
+    24, 26, 17, 22, 24, 24, 20, 31, 33, 27, 30, 29, 32, 29, 30, 33,
+    26, 34, 26, 32, 25, 29, 25, 24, 27, 29, 30, 26, 28, 28, 21, 26,
+    30, 24, 27, 32, 21, 28, 27, 20, 29, 29, 28, 29, 24, 33, 26, 27,
+    29, 28, 36, 26, 40, 28, 34, 22, 27, 25, 28, 36, 32, 29, 35, 32,
+    30, 34, 30, 29, 36, 32, 21, 34, 32, 30, 28, 34, 27, 26, 34, 28,
+    30, 28, 26, 32, 34, 26, 34, 28, 33, 33, 31, 40, 37, 33, 31, 28,
+    22, 35, 39, 39, 25, 20, 18, 21, 18, 30, 26, 25, 24, 24, 24, 23,
+    19, 0, 2, 8, 7, 25, 10, 14, 20, 8, 8, 15, 15, 8, 8, 15,
+    15, 14, 14, 14, 24, 10, 10, 20, 20, 20, 18, 18, 18, 7, 5, 4,
+    5, 33, 6, 12, 19, 10, 9, 9, 17, 24, 17, 4, 4, 4, 4, 1,
+    2, 12, 14, 17, 7, 9, 7, 31, 20, 15, 22, 28, 7, 29, 8, 21,
+    29, 13, 20, 5, 9, 6, 9, 10, 12, 16, 17, 17, 18, 20, 21, 6,
+    8, 16, 18, 8, 12, 15, 17, 11, 12, 16, 17, 18, 18, 14, 18, 14,
+    16, 17, 20, 11, 12, 14, 13, 15, 15, 16, 23, 16, 24, 21, 20, 23,
+    21, 27, 18, 17, 23, 13, 16, 19, 7, 9, 14, 23, 28, 27, 22, 16,
+    18, 22, 16, 14, 19, 19, 26, 15, 17, 15, 13, 17, 17, 15, 10, 16,
+    21, 18, 22, 13, 11, 12, 12, 2, 5, 2, 4, 4, 7, 15, 6, 8,
+    11, 6, 8, 11, 15, 11, 13, 11, 15, 15, 17, 11, 14, 10, 13, 12,
+    14, 11, 14, 15, 17, 8, 8, 11, 14, 15, 16, 7, 9, 14, 16, 13,
+    13, 5, 8, 9, 12, 15, 9, 11, 12, 10, 10, 16, 6, 8, 8, 13,
+    13, 15, 19, 10, 11, 14, 6, 9, 14, 14, 15, 19, 10, 9, 11, 9,
+    17, 10, 13, 9, 11, 11, 13, 10, 10, 11, 9, 16, 9, 13, 20, 16,
+    13, 8, 14, 10, 8, 12, 20, 17, 15, 1, 6, 2, 4, 10,
+};
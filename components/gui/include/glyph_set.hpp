@@ -0,0 +1,177 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "glyph_ink.hpp"
+
+/// @brief A set of glyphs for the rain to pick from, e.g. katakana or digits.
+/// A cell stores the index of its glyph in the set, so picking a random glyph
+/// is a single table index. The glyphs are also ranked by their ink (the lit
+/// pixels of their bitmaps), so a brightness can be shaded with a glyph of
+/// the same density.
+/// Sets are built at compile time with make_glyph_table(), and checked
+/// against the font with glyphs_in_font(), so the rain only ever picks glyphs
+/// which unscii_8_jp has and never falls back to another font.
+struct GlyphSet {
+  static constexpr int max_glyphs = 256; //< A cell stores its glyph index in a byte
+  static constexpr int num_density_buckets = 8;
+
+  const char *name{""};
+  const uint32_t *codepoints{nullptr}; //< Codepoint of each glyph, in ascending order
+  const uint8_t *by_ink{nullptr};      //< Glyph indices, from the least to the most ink
+  const std::array<char, 5> *utf8{nullptr}; //< UTF-8 of each glyph, null terminated
+  const uint8_t *utf8_lengths{nullptr};     //< Length of each glyph's UTF-8 in bytes
+  int size{0};
+
+  /// @brief Returns the codepoint of a glyph index.
+  constexpr uint32_t codepoint(uint8_t glyph) const { return codepoints[glyph]; }
+
+  /// @brief Returns a glyph whose ink matches a brightness.
+  /// The glyphs are split into equally sized buckets, from the sparsest to
+  /// the densest; the brightness picks a bucket and the variant a glyph in it.
+  /// @param brightness The brightness (0-255) of the cell.
+  /// @param variant Any value, e.g. a random glyph, to vary the glyph within
+  ///        those of the same density.
+  /// @return The glyph index.
+  constexpr uint8_t glyph_for(uint8_t brightness, uint8_t variant) const {
+    int bucket_size = std::max(size / num_density_buckets, 1);
+    int num_buckets = size / bucket_size;
+    int bucket = brightness * num_buckets / 256;
+    return by_ink[bucket * bucket_size + variant % bucket_size];
+  }
+};
+
+/// @brief The storage of a GlyphSet, built at compile time by
+///        make_glyph_table().
+template <size_t N> struct GlyphTable {
+  static_assert(N > 0 && N <= GlyphSet::max_glyphs, "a glyph set has 1 to 256 glyphs");
+  std::array<uint32_t, N> codepoints{};
+  std::array<uint8_t, N> by_ink{};
+  std::array<std::array<char, 5>, N> utf8{};
+  std::array<uint8_t, N> utf8_lengths{};
+
+  constexpr GlyphSet set(const char *name) const {
+    return {name, codepoints.data(), by_ink.data(), utf8.data(), utf8_lengths.data(), (int)N};
+  }
+};
+
+/// @brief Encodes a codepoint as UTF-8, at compile time.
+/// @return The number of bytes written, 1 to 4.
+constexpr int codepoint_to_utf8(uint32_t codepoint, char *utf8) {
+  if (codepoint < 0x80) {
+    utf8[0] = codepoint;
+    return 1;
+  } else if (codepoint < 0x800) {
+    utf8[0] = 0xC0 | (codepoint >> 6);
+    utf8[1] = 0x80 | (codepoint & 0x3F);
+    return 2;
+  } else if (codepoint < 0x10000) {
+    utf8[0] = 0xE0 | (codepoint >> 12);
+    utf8[1] = 0x80 | ((codepoint >> 6) & 0x3F);
+    utf8[2] = 0x80 | (codepoint & 0x3F);
+    return 3;
+  }
+  utf8[0] = 0xF0 | (codepoint >> 18);
+  utf8[1] = 0x80 | ((codepoint >> 12) & 0x3F);
+  utf8[2] = 0x80 | ((codepoint >> 6) & 0x3F);
+  utf8[3] = 0x80 | (codepoint & 0x3F);
+  return 4;
+}
+
+/// @brief Returns the index of a codepoint in font_codepoints, -1 if the font
+///        doesn't have it.
+constexpr int font_glyph_index(uint32_t codepoint) {
+  auto it = std::lower_bound(font_codepoints.begin(), font_codepoints.end(), codepoint);
+  return it != font_codepoints.end() && *it == codepoint ? it - font_codepoints.begin() : -1;
+}
+
+/// @brief Builds a glyph set from its codepoints, in any order.
+template <size_t N> constexpr GlyphTable<N> make_glyph_table(std::array<uint32_t, N> codepoints) {
+  GlyphTable<N> table;
+  std::sort(codepoints.begin(), codepoints.end());
+  table.codepoints = codepoints;
+  // The renderers copy the text of a glyph instead of encoding it per cell
+  for (size_t i = 0; i < N; ++i) {
+    table.utf8_lengths[i] = codepoint_to_utf8(table.codepoints[i], table.utf8[i].data());
+  }
+  auto ink = [&](int glyph) {
+    int index = font_glyph_index(table.codepoints[glyph]);
+    return index < 0 ? 0 : font_ink[index];
+  };
+  // Insertion sort, which is stable and can run at compile time
+  for (int i = 0; i < (int)N; ++i) {
+    int j = i;
+    for (; j > 0 && ink(table.by_ink[j - 1]) > ink(i); --j) {
+      table.by_ink[j] = table.by_ink[j - 1];
+    }
+    table.by_ink[j] = i;
+  }
+  return table;
+}
+
+/// @brief Returns true if the font has every glyph of the table, and no
+///        glyph is in the table twice.
+template <size_t N> constexpr bool glyphs_in_font(const GlyphTable<N> &table) {
+  for (size_t i = 0; i < N; ++i) {
+    if (font_glyph_index(table.codepoints[i]) < 0 ||
+        (i > 0 && table.codepoints[i] == table.codepoints[i - 1]))
+      return false;
+  }
+  return true;
+}
+
+/// @brief Returns the number of codepoints in a UTF-8 string.
+constexpr size_t utf8_length(const char *text) {
+  size_t length = 0;
+  for (; *text; ++text) {
+    length += (*text & 0xC0) != 0x80;
+  }
+  return length;
+}
+
+/// @brief Decodes the first N codepoints of a UTF-8 string, e.g. to build a
+///        glyph set from a string with make_glyph_table().
+template <size_t N> constexpr std::array<uint32_t, N> utf8_codepoints(const char *text) {
+  std::array<uint32_t, N> codepoints{};
+  for (size_t i = 0; i < N && *text; ++i) {
+    auto byte = (uint8_t)*text++;
+    int continuation = byte >= 0xF0 ? 3 : byte >= 0xE0 ? 2 : byte >= 0xC0 ? 1 : 0;
+    uint32_t codepoint = continuation ? byte & (0x3F >> continuation) : byte;
+    for (; continuation > 0 && *text; --continuation) {
+      codepoint = codepoint << 6 | ((uint8_t)*text++ & 0x3F);
+    }
+    codepoints[i] = codepoint;
+  }
+  return codepoints;
+}
+
+// The glyph sets of the rain. unscii_8_jp has no ASCII, so the digits are
+// its enclosed alphanumerics.
+
+inline constexpr auto katakana_glyphs = make_glyph_table([] {
+  std::array<uint32_t, 0x30FF - 0x30A0 + 1> codepoints{};
+  for (size_t i = 0; i < codepoints.size(); ++i) {
+    codepoints[i] = 0x30A0 + i;
+  }
+  return codepoints;
+}());
+inline constexpr auto digit_glyphs = make_glyph_table<10>(utf8_codepoints<10>("⓪①②③④⑤⑥⑦⑧⑨"));
+inline constexpr auto binary_glyphs = make_glyph_table<2>(utf8_codepoints<2>("⓪①"));
+inline constexpr auto hex_glyphs =
+    make_glyph_table<16>(utf8_codepoints<16>("⓪①②③④⑤⑥⑦⑧⑨ⒶⒷⒸⒹⒺⒻ"));
+
+static_assert(glyphs_in_font(katakana_glyphs), "unscii_8_jp should have every katakana glyph");
+static_assert(glyphs_in_font(digit_glyphs), "unscii_8_jp should have every digit glyph");
+static_assert(glyphs_in_font(binary_glyphs), "unscii_8_jp should have every binary glyph");
+static_assert(glyphs_in_font(hex_glyphs), "unscii_8_jp should have every hex glyph");
+static_assert(katakana_glyphs.utf8_lengths[2] == 3 && katakana_glyphs.utf8[2][0] == '\xE3' &&
+                  katakana_glyphs.utf8[2][1] == '\x82' && katakana_glyphs.utf8[2][2] == '\xA2',
+              "U+30A2 should be encoded as E3 82 A2");
+
+inline constexpr GlyphSet katakana_glyph_set = katakana_glyphs.set("katakana");
+inline constexpr GlyphSet digit_glyph_set = digit_glyphs.set("digits");
+inline constexpr GlyphSet binary_glyph_set = binary_glyphs.set("binary");
+inline constexpr GlyphSet hex_glyph_set = hex_glyphs.set("hex");
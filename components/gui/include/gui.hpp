@@ -10,8 +10,12 @@
 #include "display.hpp"
 #include "high_resolution_timer.hpp"
 #include "matrix_rain.hpp"
+#include "quality_controller.hpp"
+#include "rng.hpp"
 #include "terminal.hpp"
 
+#include "esp_random.h"
+
 class Gui : public espp::BaseComponent {
 public:
   struct Config {
@@ -20,6 +24,10 @@ public:
     uint32_t terminal_duration_ms{2000};
     uint32_t matrix_rain_speed{40}; ///< Update interval for matrix rain in ms
     uint32_t timer_interval_ms{30};
+    uint32_t seed{0}; ///< Seed for the random number generators, 0 to pick a random seed
+    bool adaptive_quality{true}; ///< Lower the rain's quality when frames take too long
+    uint32_t target_frame_time_ms{0}; ///< Frame time to hold, 0 for timer_interval_ms
+    int num_quality_levels{4};        ///< Number of rain quality levels
   };
 
   explicit Gui(const Config &config)
@@ -27,7 +35,15 @@ public:
       , timer_interval_ms_(config.timer_interval_ms)
       , boot_line_delay_ms_(config.boot_line_delay_ms)
       , terminal_duration_ms_(config.terminal_duration_ms)
-      , matrix_rain_speed_(config.matrix_rain_speed) {
+      , matrix_rain_speed_(config.matrix_rain_speed)
+      , seed_(config.seed)
+      , rng_(config.seed ? config.seed : esp_random())
+      , adaptive_quality_(config.adaptive_quality)
+      , quality_({
+            .target_frame_us = 1000 * (config.target_frame_time_ms ? config.target_frame_time_ms
+                                                                   : config.timer_interval_ms),
+            .num_levels = config.num_quality_levels,
+        }) {
     init_ui();
     logger_.debug("Starting task...");
     // now start the gui updater task
@@ -57,6 +73,11 @@ public:
 
   MatrixRain *get_matrix_rain() { return matrix_rain_.get(); }
 
+  /// @brief Returns the current quality level of the rain, in
+  ///        [0, get_num_quality_levels()), the highest being full quality.
+  int get_quality_level() const { return quality_.level(); }
+  int get_num_quality_levels() const { return quality_.num_levels(); }
+
 protected:
   enum class Mode { BOOT, TERMINAL, MATRIX_RAIN };
 
@@ -64,6 +85,7 @@ protected:
   void deinit_ui();
 
   void update();
+  void update_quality(uint32_t frame_us);
 
   uint32_t timer_interval_ms_{30};
 
@@ -101,6 +123,7 @@ protected:
   uint32_t terminal_start_time_{0};
   uint32_t terminal_duration_ms_{2000};
   uint32_t matrix_rain_start_time_{0};
+  uint32_t last_rain_log_time_{0};
   uint32_t last_char_time_{0};
 
   void draw_boot_screen();
@@ -155,6 +178,13 @@ protected:
   uint32_t matrix_rain_speed_{1};
   uint8_t matrix_rain_num_chars_{5};
 
+  uint32_t seed_{0};
+  Rng rng_;
+
+  // Measures the frame time of the current scene and picks the rain quality
+  bool adaptive_quality_{true};
+  QualityController quality_;
+
   std::unique_ptr<MatrixRain> matrix_rain_;
 
   // Character cell size for MatrixRain config
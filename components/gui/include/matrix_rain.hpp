@@ -1,36 +1,46 @@
 #pragma once
 
-#include <deque>
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <functional>
 #include <lvgl.h>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
+#include "brightness_map.hpp"
+#include "brightness_sequence.hpp"
+#include "cell_grid.hpp"
 #include "format.hpp"
+#include "frame_exchange.hpp"
+#include "glyph_atlas.hpp"
+#include "rain_engine.hpp"
+#include "rng.hpp"
+#include "task.hpp"
+#include "worker_pool.hpp"
 
+/// @brief LVGL front end of the matrix rain.
+/// The simulation itself lives in RainEngine; this class sizes the grid from
+/// the font, feeds the engine the clock and the image, and draws the render
+/// keys it produces with the configured renderer.
+/// With CONFIG_MRP_RAIN_SIM_TASK, the engine runs in its own task on the
+/// other core and update() only draws the newest frame it has finished.
 class MatrixRain {
 public:
   /// @brief Configuration for the MatrixRain effect.
   /// This struct contains parameters to customize the appearance and behavior
-  /// of the rain effect.
-  struct Config {
-    int screen_width = 128;           //< Size of the screen in pixels
-    int screen_height = 128;          //< Size of the screen in pixels
-    int char_width = 8;               //< Size of each character in pixels
-    int char_height = 8;              //< Size of each character in pixels
-    int min_drop_length = 6;          //< Min length of a drop in characters
-    int max_drop_length = 16;         //< Max length of a drop in characters
-    int fade_duration_ms = 100;       //< Duration to fade a character in ms
-    int head_mutate_interval_ms = 10; //< Interval to mutate the head of a drop in ms
-    int drop_spawn_interval_ms = 200; //< Interval to spawn a new drop in ms
-    int drop_spawn_chance = 5;        //< Chance to spawn a drop on a frame. 1/x (1 in x) chance.
-    int min_speed_ms = 10;            //< Minimum speed of a drop in ms
-    int speed_range_ms = 100;         //< Range of speed variation in ms (max - min)
-    int image_reveal_min_duration_ms = 3000;  //< Min duration to show the image in ms
-    int image_reveal_max_duration_ms = 5000;  //< Max duration to show the image in ms
-    int image_erase_duration_ms = 2000;       //< Duration of the erasing animation in ms
-    int image_reveal_min_interval_ms = 8000;  //< Min interval between image reveals in ms
-    int image_reveal_max_interval_ms = 15000; //< Max interval between image reveals in ms
-    int image_drop_speed_ms = 10;             //< Speed of static drops for image reveal
+  /// of the rain effect. The simulation parameters are inherited from
+  /// RainEngine::Params.
+  struct Config : public RainEngine::Params {
+    int screen_width = 128; //< Size of the screen in pixels
+    int screen_height = 128; //< Size of the screen in pixels
+    int char_width = 8;     //< Size of each character in pixels
+    int char_height = 8;    //< Size of each character in pixels
+    /// Time source in ms, lv_tick_get() if not set. Together with a fixed
+    /// seed, this lets the rain be replayed exactly (see RainReplay).
+    std::function<uint32_t()> clock{nullptr};
   };
 
   /// @brief Constructor for the MatrixRain effect.
@@ -46,6 +56,8 @@ public:
   /// @brief Deinitializes the MatrixRain effect, cleaning up resources.
   void deinit();
   /// @brief Updates the MatrixRain effect.
+  /// When the simulation runs in its own task, this only draws the newest
+  /// frame the task has finished (if there is a new one).
   void update();
   /// @brief Restarts the MatrixRain effect, resetting all drops and cells.
   void restart();
@@ -62,13 +74,73 @@ public:
   /// Passing nullptr will disable image rendering mode and revert to random rain.
   /// @param img Pointer to the LVGL image descriptor.
   void set_image(const lv_img_dsc_t *img);
+  /// @brief Sets a precomputed brightness map (e.g. from a BrightnessCache)
+  ///        to be rendered using the matrix rain effect, like set_image().
+  /// @param brightness_map get_cols() x get_rows() values, row-major.
+  /// @return False if the map doesn't match the grid, the image is then
+  ///         unchanged.
+  bool set_image_brightness_map(std::vector<uint8_t> brightness_map);
+  /// @brief Sets an animated image, streamed from a brightness map sequence
+  ///        (.bmseq, see BrightnessSequence), to be rendered using the matrix
+  ///        rain effect.
+  /// Playback is limited to the reveal: the sequence only advances while the
+  /// image is revealed, holds its frame while the rain washes the image away
+  /// and in between reveals, and resumes from that frame at the next reveal
+  /// (looping at the end of the file). A low priority task reads each next
+  /// frame from the file while the current one is shown, so at most two
+  /// frames are in memory and the rain never waits on the file system.
+  /// Setting an image or another sequence stops the sequence.
+  /// @param file The sequence file, which must match the grid.
+  /// @return False if the file can't be read or doesn't match the grid, the
+  ///         image is then unchanged.
+  bool set_image_sequence(const std::filesystem::path &file);
+
+  /// @brief Returns the brightness map of the current image, empty if no
+  ///        image is set.
+  const std::vector<uint8_t> &get_image_brightness_map() const { return image_brightness_map_; }
+
+  /// @brief Returns the number of columns of the grid, 0 before init().
+  int get_cols() const { return cols_; }
+  /// @brief Returns the number of rows of the grid, 0 before init().
+  int get_rows() const { return rows_; }
 
   /// @brief Sets the minimum brightness for the image rendering mode.
   /// This value is used to determine the minimum brightness of pixels in the image
   /// that will be rendered. Pixels with brightness below this value will not be shown.
   /// @param brightness The minimum brightness value (0-255).
   /// Default is 0, meaning all pixels will be shown.
-  void set_min_image_brightness(uint8_t brightness) { min_image_brightness_ = brightness; }
+  void set_min_image_brightness(uint8_t brightness);
+
+  /// @brief Scales how much work the rain does, to hold a frame time.
+  /// The highest level is the configured rain. Each level below it spawns
+  /// fewer drops, caps the number of falling drops lower and uses fewer fade
+  /// levels, so fewer cells change (and have to be redrawn) every frame.
+  /// @param level The quality level, in [0, num_levels).
+  /// @param num_levels The number of quality levels.
+  void set_quality_level(int level, int num_levels);
+
+  /// @brief Live counters of the rain, for logging and frame time dashboards.
+  struct Stats : public RainEngine::Stats {
+    int rows_skipped = 0; //< Rows not redrawn during the last update
+  };
+
+  /// @brief Returns the counters of the frame drawn by the last update().
+  /// They are handed over with the frame, so reading them is cheap: nothing
+  /// is scanned or locked. Only call this from the task which calls update().
+  Stats get_stats() const;
+
+  /// @brief Returns how many rows were unchanged, and therefore not redrawn,
+  ///        during the last update.
+  /// @return The number of rows skipped during the last update.
+  int get_rows_skipped() const { return rows_skipped_; }
+
+  /// @brief Returns the simulation behind the effect, nullptr before init().
+  /// @note The engine keeps changing while the simulation task is running.
+  const RainEngine *get_engine() const { return engine_.get(); }
+
+  /// @brief Returns the hash of the last simulated frame, see
+  ///        RainEngine::frame_hash().
+  uint64_t get_frame_hash() const;
 
   /// @brief Prints the current image brightness map to the console for debugging.
   void print_image_brightness_map();
@@ -76,60 +148,77 @@ public:
   void debug_show_image();
 
 private:
-  enum class ImageRevealState {
-    NORMAL,    //< Standard random rain
-    CLEARING,  //< Stop spawning, let existing drops fall
-    REVEALING, //< Show the image with static drops
-    ERASING    //< Wash away the image with random drops
-  };
+  /// A glyph resolved from the font for the framebuffer renderer.
+  using Glyph = GlyphAtlas::Glyph;
 
-  struct CharCell {
-    uint32_t codepoint{0};
-    uint32_t fade_start_time{0};
-    bool fading{false};
-    bool is_head{false};
+  /// A simulated frame, as handed over by the simulation task.
+  struct Frame {
+    std::vector<uint32_t> keys; //< Render key of each cell, row-major
+    RainEngine::Stats stats;    //< Counters of the engine after the frame
   };
 
-  struct Drop {
-    int head_row{-1};
-    int length{0};
-    uint32_t last_mutate_time{0};
-    uint32_t last_advance_time{0};
-    bool active{true};
-    int speed_ms{40};           // Per-drop speed in ms
-    bool is_image_drop{false};  //< True if this drop is for revealing the image
-    std::deque<uint32_t> chars; // head at back, tail at front
-  };
-
-  struct Column {
-    std::vector<CharCell> cells; // one per row
-    std::vector<Drop> drops;
-    uint32_t last_spawn_time{0};
-  };
-
-  std::vector<Column> columns_;
+  std::unique_ptr<RainEngine> engine_;
+  mutable std::mutex engine_mutex_; // held while the engine is used, it may be simulating in sim_task_
+  Rng seed_rng_; // seeds a new engine on every init()
+  // With the simulation task, each frame's render keys and stats are handed
+  // over to update() through frames_ without any locking.
+  std::unique_ptr<espp::Task> sim_task_;
+  FrameExchange<Frame> frames_;
+  RainEngine::Stats frame_stats_; // stats of the frame drawn by the last update()
+  std::chrono::steady_clock::time_point next_sim_time_;
+  // Rows are built / rasterized by the row workers (and the calling task) in
+  // parallel, see draw_rows()
+  std::unique_ptr<WorkerPool> row_workers_;
+  std::vector<uint8_t> row_dirty_; // rows changed by the current update, one entry per row
   std::vector<lv_obj_t *> row_labels_;
+  std::vector<char> row_text_; // static text of each row label, row_text_stride_ bytes per row
+  size_t row_text_stride_{0};
+  std::unique_ptr<CellGrid> cell_grid_;
+  lv_obj_t *canvas_{nullptr};
+  uint16_t *framebuffer_{nullptr}; // RGB565, screen_width x screen_height
+  std::vector<Glyph> glyphs_;      // indexed like config_.glyph_set
+  std::unique_ptr<GlyphAtlas> glyph_atlas_; // tiles of glyphs_, if enabled and allocated
+  std::vector<uint32_t> cell_keys_; // render key of each cell on screen, row-major
   int cols_{0};
   int rows_{0};
+  int line_height_{0};
+  int rows_skipped_{0};
   const lv_font_t *font_{nullptr};
   lv_obj_t *parent_{nullptr};
   lv_obj_t *prompt_label_{nullptr};
   Config config_;
-  uint32_t last_update_{0};
   bool image_mode_{false};
   std::vector<uint8_t> image_brightness_map_;
+  BrightnessMap brightness_mapper_; // computes image_brightness_map_ from an image
   uint8_t min_image_brightness_{0};
-  ImageRevealState image_state_{ImageRevealState::NORMAL};
-  uint32_t state_transition_time_{0};
-
-  void spawn_drop(Column &col, uint32_t now, bool is_image_drop = false);
-  void update_drop(Column &col, Drop &drop, uint32_t now);
-  void update_fade(Column &col, uint32_t now);
-  void update_row_labels(uint32_t now);
-  bool is_screen_clear();
-  void set_next_reveal_time();
-
-  static uint32_t random_katakana();
-  static void unicode_to_utf8(uint32_t unicode, char *utf8);
-  static uint8_t get_pixel_brightness(const lv_img_dsc_t *img, int x, int y);
+  RainEngine::Quality quality_;
+  // The frames of an animated image are read ahead by sequence_task_, and
+  // swapped in (with engine_mutex_ held) by advance_sequence()
+  std::unique_ptr<BrightnessSequence> sequence_;
+  std::unique_ptr<espp::Task> sequence_task_;
+  uint32_t sequence_frame_time_{0}; // engine time the front frame was shown at
+
+  void start_sim_task();
+  bool simulate(std::mutex &m, std::condition_variable &cv);
+  void stop_sequence();
+  bool read_sequence(std::mutex &m, std::condition_variable &cv);
+  void advance_sequence();
+
+  void draw_rows(const WorkerPool::chunk_fn &fn);
+
+  void update_row_labels(const uint32_t *keys);
+  bool build_row_text(int y, const uint32_t *row_keys);
+
+  void update_cell_grid(const uint32_t *keys);
+
+  void init_framebuffer();
+  void deinit_framebuffer();
+  void build_glyph_cache();
+  void update_framebuffer(const uint32_t *keys);
+  bool draw_framebuffer_row(int y, const uint32_t *row_keys);
+  void draw_cell(int x, int y, const Glyph *glyph, uint16_t color);
+  void copy_tile(int x, int y, const uint16_t *tile);
+
+  static bool get_brightness_image(const lv_img_dsc_t *img, BrightnessMap::Image &image);
+  static bool find_glyph(const lv_font_t *font, uint32_t codepoint, Glyph &glyph);
 };
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+
+/// @brief Picks a quality level which keeps the measured frame time under a
+///        target.
+/// Frame times are averaged over a window of frames, and one decision is
+/// made per window: the level drops as soon as the average goes over the
+/// target, but only rises again once the average is well under the target
+/// and the level has held for a few windows. The gap between the two
+/// thresholds and the hold keep the level from flapping between two values.
+class QualityController {
+public:
+  struct Config {
+    uint32_t target_frame_us = 30000; //< Frame time to stay under, in us
+    int num_levels = 4;               //< Number of quality levels, 0 is the lowest
+    int window_frames = 16;           //< Number of frames averaged for each decision
+    int lower_percent = 100; //< Lower the level when the average is over this % of the target
+    int raise_percent = 60;  //< Raise the level when the average is under this % of the target
+    int hold_windows = 4;    //< Windows to wait after a change before raising the level
+  };
+
+  /// @brief Constructor for the QualityController, which starts at the
+  ///        highest level.
+  /// @param config Configuration of the controller.
+  explicit QualityController(const Config &config)
+      : config_(config) {
+    config_.num_levels = std::max(config_.num_levels, 1);
+    config_.window_frames = std::max(config_.window_frames, 1);
+    level_ = config_.num_levels - 1;
+  }
+
+  /// @brief Forgets the frames measured so far, e.g. when the scene changes.
+  /// The level is kept.
+  void restart() {
+    window_sum_us_ = 0;
+    window_frames_ = 0;
+    hold_ = 0;
+  }
+
+  /// @brief Adds the measured time of a frame.
+  /// @param frame_us The time the frame took, in us.
+  /// @return True if the level changed.
+  bool add_frame(uint32_t frame_us) {
+    window_sum_us_ += frame_us;
+    if (++window_frames_ < config_.window_frames) {
+      return false;
+    }
+    average_frame_us_ = window_sum_us_ / window_frames_;
+    window_sum_us_ = 0;
+    window_frames_ = 0;
+    if (hold_ > 0) {
+      hold_--;
+    }
+
+    uint64_t average_percent = (uint64_t)average_frame_us_ * 100;
+    int level = level_;
+    if (average_percent > (uint64_t)config_.target_frame_us * config_.lower_percent) {
+      level = std::max(level_ - 1, 0);
+    } else if (average_percent < (uint64_t)config_.target_frame_us * config_.raise_percent &&
+               hold_ == 0) {
+      level = std::min(level_ + 1, config_.num_levels - 1);
+    }
+    if (level == level_) {
+      return false;
+    }
+    level_ = level;
+    hold_ = config_.hold_windows;
+    return true;
+  }
+
+  /// @brief The current quality level, in [0, num_levels).
+  int level() const { return level_; }
+  /// @brief The number of quality levels.
+  int num_levels() const { return config_.num_levels; }
+  /// @brief The average frame time of the last full window, in us.
+  uint32_t average_frame_us() const { return average_frame_us_; }
+
+protected:
+  Config config_;
+  int level_{0};
+  int hold_{0}; // windows left before the level may rise
+  uint64_t window_sum_us_{0};
+  int window_frames_{0};
+  uint32_t average_frame_us_{0};
+};
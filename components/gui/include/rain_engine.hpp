@@ -0,0 +1,378 @@
+#pragma once
+
+#include <climits>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "glyph_set.hpp"
+#include "rng.hpp"
+#include "timer_wheel.hpp"
+
+/// @brief Simulation of the matrix rain: drops, cells, fades and the image
+/// reveal state machine.
+/// The engine has no dependency on LVGL or ESP-IDF; time comes from an
+/// injected clock, so it can be run (and profiled) on a host. Each update
+/// produces a render key per cell, which is all a renderer needs to draw the
+/// frame.
+/// The simulation is incremental: a column is only painted again when one of
+/// its drops moves (or a head glyph is covered by another drop), the body of a
+/// drop holds its fade until the drop moves on, and only the cells which are
+/// fading are visited on every update. The work per update depends on the
+/// number of drop advances and fading cells, not on the size of the grid.
+/// The rain can have depth layers behind it. Each layer is a rain of its own
+/// (without the image reveal), and the layers are composited into the one
+/// grid of render keys: a cell shows the nearest layer which has a glyph in
+/// it, dimmed by the layer's intensity. A drop budget caps the drops falling
+/// across all the layers, see Params::drop_budget.
+class RainEngine {
+public:
+  /// @brief A layer of rain behind the front one, for depth. Farther layers
+  ///        are usually slower and dimmer.
+  struct Layer {
+    int min_speed_ms = 100;     //< Minimum speed of the layer's drops in ms
+    int speed_range_ms = 200;   //< Range of the layer's drop speeds in ms (max - min)
+    int intensity_percent = 50; //< Brightness of the layer, in percent of the front rain's
+    int density_percent = 100;  //< Rate of new drops, in percent of the front rain's
+  };
+
+  /// @brief Parameters which tune the look and behavior of the rain.
+  struct Params {
+    int min_drop_length = 6;          //< Min length of a drop in characters
+    int max_drop_length = 16;         //< Max length of a drop in characters
+    int fade_duration_ms = 100;       //< Duration to fade a character in ms
+    int fade_levels = 16;             //< Number of distinct brightness levels while fading
+    int head_mutate_interval_ms = 10; //< Interval to mutate the head of a drop in ms
+    int drop_spawn_interval_ms = 200; //< Interval to spawn a new drop in ms
+    int drop_spawn_chance = 5;        //< Chance to spawn a drop on a frame. 1/x (1 in x) chance.
+    int frame_interval_ms = 30;       //< Expected interval between calls to update() in ms
+    int min_speed_ms = 10;            //< Minimum speed of a drop in ms
+    int speed_range_ms = 100;         //< Range of speed variation in ms (max - min)
+    int image_reveal_min_duration_ms = 3000;  //< Min duration to show the image in ms
+    int image_reveal_max_duration_ms = 5000;  //< Max duration to show the image in ms
+    int image_erase_duration_ms = 2000;       //< Duration of the erasing animation in ms
+    int image_reveal_min_interval_ms = 8000;  //< Min interval between image reveals in ms
+    int image_reveal_max_interval_ms = 15000; //< Max interval between image reveals in ms
+    int image_drop_speed_ms = 10;             //< Speed of static drops for image reveal
+    int max_drops = 0; //< Capacity of the drop pool, 0 to size it from the grid and drop timing
+    const GlyphSet *glyph_set = &katakana_glyph_set; //< Glyphs the rain picks from
+    uint32_t seed = 0; //< Seed for the random number generator
+    std::vector<Layer> layers; //< Depth layers behind the rain, from the nearest to the farthest
+    /// Max drops falling at once across the rain and its layers, shared out
+    /// by expected_drops(). 0 for no cap without layers, and with layers for
+    /// half the drops the rain alone is expected to have, which take about
+    /// as long to simulate. Image drops only fall on a screen which is clear
+    /// of other drops, one per column, and are not capped.
+    int drop_budget = 0;
+  };
+
+  /// @brief How much work the rain does. It can be lowered to hold a frame
+  ///        time on a busy system; the defaults are full quality.
+  struct Quality {
+    int spawn_percent = 100;  //< Rate of new drops, in percent of the configured rate
+    int max_active_drops = 0; //< Max number of falling drops across the layers, 0 for no cap
+    int fade_levels = 0;      //< Brightness levels while fading, 0 for Params::fade_levels
+  };
+
+  /// @brief Live counters of the simulation. They are kept up to date as
+  ///        drops spawn and retire and as cells fade, so reading them never
+  ///        scans the grid.
+  struct Stats {
+    int active_drops = 0;       //< Drops currently falling, image drops and layers included
+    int active_layer_drops = 0; //< Drops currently falling in the depth layers
+    int active_image_drops = 0; //< Drops currently falling which reveal the image
+    int fading_cells = 0;       //< Cells fading out after the last update
+  };
+
+  /// @brief Configuration for the RainEngine.
+  struct Config : public Params {
+    int cols = 16;                        //< Number of character columns
+    int rows = 9;                         //< Number of character rows
+    std::function<uint32_t()> clock{nullptr}; //< Returns the current time in ms
+  };
+
+  static constexpr uint32_t head_color = 0xB6FF00; //< RGB color of the head of a drop
+  static constexpr uint32_t body_color = 0x00FF00; //< RGB color of a drop's body
+
+  /// The kind of a cell, as stored in its render key.
+  enum KeyKind : uint32_t { KEY_HEAD = 1, KEY_BODY = 2, KEY_FADING = 3 };
+
+  // A cell's render key packs everything that determines how the cell looks,
+  // so a cell only needs to be redrawn when its key changes. A key of 0 is a
+  // blank cell. The glyph is its index in the glyph set, so renderers index
+  // their per-glyph tables with it directly.
+  static constexpr uint32_t key_glyph_mask = 0xFF;
+  static constexpr int key_kind_shift = 21;
+  static constexpr int key_level_shift = 23;
+
+  static constexpr uint32_t make_key(uint8_t glyph, KeyKind kind, uint32_t level = 0) {
+    return glyph | (kind << key_kind_shift) | (level << key_level_shift);
+  }
+  /// @brief Returns the glyph set index of the glyph shown by a (non-blank) cell.
+  static constexpr uint8_t key_glyph(uint32_t key) { return key & key_glyph_mask; }
+  /// @brief Returns the kind of a (non-blank) cell.
+  static constexpr KeyKind key_kind(uint32_t key) {
+    return KeyKind(key >> key_kind_shift & 0x3);
+  }
+  /// @brief Returns the green level (0-255) of a fading cell.
+  static constexpr uint32_t key_level(uint32_t key) { return key >> key_level_shift & 0xFF; }
+  /// @brief Returns the RGB color of a (non-blank) cell.
+  static constexpr uint32_t key_color(uint32_t key) {
+    switch (key_kind(key)) {
+    case KEY_HEAD:
+      return head_color;
+    case KEY_BODY:
+      return body_color;
+    default:
+      return key_level(key) << 8;
+    }
+  }
+
+  /// @brief Returns rain parameters scaled to the number of character rows.
+  /// These heuristics were tuned on a 128x128 screen with 8x8 characters.
+  /// @param num_rows The screen height divided by the character height.
+  static Params scaled_params(int num_rows);
+  /// @brief Returns depth layers for a rain, each slower and dimmer than the
+  ///        one in front of it.
+  /// @param params The parameters of the front rain.
+  /// @param num_layers The number of layers behind the front rain.
+  static std::vector<Layer> depth_layers(const Params &params, int num_layers);
+
+  /// @brief Constructor for the RainEngine.
+  /// @param config Configuration of the engine. config.clock must be set.
+  explicit RainEngine(const Config &config);
+
+  /// @brief Resets all drops and cells.
+  void restart();
+  /// @brief Advances the simulation to the current time and updates the
+  ///        render keys.
+  void update();
+
+  /// @brief Sets the per-cell brightness of the image to reveal.
+  /// @param brightness_map cols x rows brightness values (row-major), or an
+  ///        empty vector to disable the image reveal.
+  void set_image_brightness(std::vector<uint8_t> brightness_map);
+  /// @brief Replaces the brightness of the image being revealed, e.g. with the
+  ///        next frame of an animated image.
+  /// Only the cells whose brightness changed are updated, and nothing is
+  /// allocated, so this can be called on every frame.
+  /// @param brightness_map cols x rows brightness values (row-major). Ignored
+  ///        if no image was set with set_image_brightness().
+  void update_image_brightness(const uint8_t *brightness_map);
+  /// @brief Returns true while the image is shown (the reveal state machine
+  ///        is in its REVEALING state).
+  bool is_revealing() const {
+    return image_mode_ && image_state_ == ImageRevealState::REVEALING;
+  }
+  /// @brief Sets the minimum brightness of cells shown during the reveal.
+  void set_min_image_brightness(uint8_t brightness) {
+    min_image_brightness_ = brightness;
+    keys_dirty_ = true;
+  }
+  /// @brief Sets how much work the rain does, see Quality.
+  /// Drops which are already falling are not affected.
+  void set_quality(const Quality &quality);
+  const Quality &quality() const { return quality_; }
+
+  /// @brief Returns the glyphs the rain picks from.
+  const GlyphSet &glyph_set() const { return *glyph_set_; }
+  int cols() const { return cols_; }
+  int rows() const { return rows_; }
+  /// @brief Render keys of the current frame, cols x rows, row-major, with
+  ///        the depth layers composited.
+  const uint32_t *keys() const { return layers_.empty() ? keys_.data() : frame_keys_.data(); }
+  /// @brief Render key of one cell in the current frame.
+  uint32_t key(int x, int y) const { return keys()[y * cols_ + x]; }
+  /// @brief Number of drops currently falling, in every layer.
+  int active_drops() const;
+  /// @brief Counters of the current frame, see Stats.
+  Stats stats() const;
+  /// @brief Capacity of the drop pools of every layer.
+  int max_drops() const;
+  /// @brief Returns the number of drops this layer is expected to have
+  ///        falling on average, without the depth layers: the rate at which
+  ///        drops spawn times how long a drop takes to fall (Little's law).
+  float expected_drops() const;
+  /// @brief Returns the cap on the drops falling across the layers at full
+  ///        quality, 0 for none. See Params::drop_budget.
+  int drop_budget() const { return drop_budget_; }
+  /// @brief Returns the memory of the engine and its layers in bytes, the
+  ///        engine itself included.
+  size_t memory_bytes() const;
+  /// @brief Time of the last update, from the clock.
+  uint32_t last_update_time() const { return last_update_; }
+  /// @brief Returns a hash (64 bit FNV-1a) of the render keys of the current
+  ///        frame, i.e. of every cell's glyph, kind and fade level.
+  /// Two runs with the same config, seed and clock ticks produce the same
+  /// sequence of hashes, which makes it cheap to check that a change didn't
+  /// alter the output.
+  uint64_t frame_hash() const;
+
+protected:
+  enum class ImageRevealState {
+    NORMAL,    //< Standard random rain
+    CLEARING,  //< Stop spawning, let existing drops fall
+    REVEALING, //< Show the image with static drops
+    ERASING    //< Wash away the image with random drops
+  };
+
+  /// State of one character cell, packed so the whole grid stays small and
+  /// can be stored contiguously.
+  struct Cell {
+    enum Flags : uint8_t {
+      LIT = 1 << 0,    //< The cell shows a glyph
+      HEAD = 1 << 1,   //< The cell is the head of a drop
+      FADING = 1 << 2, //< The cell is fading out
+      QUEUED = 1 << 3, //< The cell is in fading_, which it only leaves in update_fade()
+      PINNED = 1 << 4, //< The cell is in a drop's body, its fade is held until the drop moves
+    };
+    uint8_t glyph{0};       //< Index in the glyph set
+    uint8_t flags{0};       //< Combination of Flags
+    uint16_t fade_start{0}; //< Low 16 bits of the tick at which the fade started, or the
+                            //< time the cell has been fading for while PINNED
+  };
+  static_assert(sizeof(Cell) == 4, "Cell should stay packed into 4 bytes");
+
+  /// A drop lives in a slot of the drop pool, and its glyphs are kept in a
+  /// fixed ring buffer owned by that slot, so drops never allocate.
+  struct Drop {
+    int head_row{-1};
+    int length{0};
+    int column{0};
+    bool active{true};
+    int speed_ms{40};          // Per-drop speed in ms
+    bool is_image_drop{false}; //< True if this drop is for revealing the image
+    uint8_t *chars{nullptr};   //< Ring buffer of `length` glyph indices, oldest (tail) first
+    int tail{0};               //< Index of the tail glyph in chars, the head is just before it
+    int prev{-1};              //< Previous drop (pool index) in the same column, -1 for none
+    int next{-1};              //< Next drop (pool index) in the same column, -1 for none
+
+    /// Glyph `i` characters behind the head (0 is the head).
+    uint8_t &glyph(int i) { return chars[(tail + length - 1 - i) % length]; }
+  };
+
+  struct Column {
+    int first_drop{-1}; //< Pool index of the oldest drop in this column, -1 for none
+    int last_drop{-1};  //< Pool index of the newest drop in this column, -1 for none
+    bool spawn_parked{false}; //< Spawning is paused until the rain may spawn again
+    bool dirty{false};        //< The drops moved, so the column is painted again this update
+  };
+
+  /// How fast a cell fades, in fixed-point so the per-cell fade math is just
+  /// a compare, a multiply and a shift.
+  struct FadeRate {
+    uint16_t duration_ms{1}; //< Time for the fade to complete
+    uint32_t step_rate{0};   //< Fade steps per ms, Q16 fixed-point
+  };
+  static constexpr int fade_steps = 256; //< Resolution of the fade progress
+
+  Config config_;
+  std::function<uint32_t()> clock_;
+  const GlyphSet *glyph_set_{nullptr};
+  std::vector<std::unique_ptr<RainEngine>> layers_; // depth layers, nearest first
+  int cols_{0};
+  int rows_{0};
+  std::vector<Cell> cells_;     // cols_ x rows_, row-major
+  std::vector<uint32_t> keys_;  // render key of each cell, cols_ x rows_, row-major
+  std::vector<uint32_t> frame_keys_; // keys_ with the layers composited, only with layers
+  // With layers, every engine records the keys which changed, so only those
+  // cells are composited again. See set_key().
+  bool track_changes_{false};
+  bool all_keys_changed_{false};     // every key may have changed
+  std::vector<uint8_t> key_changed_; // the cell is in changed_keys_
+  std::vector<int> changed_keys_;
+  uint8_t dim_levels_[256]{}; // green level -> level once dimmed, as a layer
+  int drop_budget_{0};        // cap on the drops across the layers, 0 for none
+  int drop_cap_{INT_MAX};     // max drops of this layer, its share of the budget
+  bool spawn_held_{false}; // a layer doesn't spawn while the front rain doesn't
+  std::vector<Column> columns_;
+  std::vector<Drop> drops_;          // drop pool, never resized after init
+  std::vector<int> free_drops_;      // free slots of the drop pool
+  std::vector<uint8_t> drop_glyphs_; // glyph ring buffers of every slot of the drop pool
+  std::vector<int> dirty_columns_;   // columns to paint again, see Column::dirty
+  std::vector<int> fading_;          // cells which may be fading, see Cell::QUEUED
+  // Drop advances, head mutations and column spawns are timers in the wheel,
+  // see the *_timer() functions for the ids.
+  TimerWheel timers_;
+  float spawn_log_q_{0}; // log(1 - 1 / drop_spawn_chance), for sampling spawn delays
+  uint32_t last_update_{0};
+  int active_image_drops_{0}; // drops of the pool with is_image_drop set
+  int fading_cells_{0};       // cells with Cell::FADING set, counted by update_fade()
+  bool image_mode_{false};
+  std::vector<uint8_t> image_brightness_map_;
+  std::vector<FadeRate> image_fade_rates_; // fade rate of each cell while revealing the image
+  FadeRate fade_rate_;                     // fade rate of every cell in the normal rain
+  std::vector<uint8_t> fade_lut_;          // fade step -> green level, fade_steps entries
+  uint16_t gradient_step_ms_{0};           // fade offset between neighboring cells of a drop
+  bool keys_dirty_{false};                 // every key needs to be recomputed on the next update
+  uint8_t min_image_brightness_{0};
+  Quality quality_;
+  ImageRevealState image_state_{ImageRevealState::NORMAL};
+  uint32_t state_transition_time_{0};
+  Rng rng_;
+
+  void init_drop_pool();
+  void init_layers();
+  void track_key_changes();
+  void apply_drop_budget();
+  void update_at(uint32_t now);
+  void hold_spawns(bool hold, uint32_t now);
+  void resume_parked_spawns(uint32_t now);
+  void composite();
+  uint32_t composite_key(int index) const;
+  void clear_changes();
+  int pool_drops() const { return drops_.size() - free_drops_.size(); }
+  uint32_t dim_key(uint32_t key) const {
+    uint32_t green = key_kind(key) == KEY_FADING ? key_level(key) : 0xFF;
+    return make_key(key_glyph(key), KEY_FADING, dim_levels_[green]);
+  }
+  void set_key(int index, uint32_t key) {
+    if (track_changes_ && key != keys_[index] && !key_changed_[index]) {
+      key_changed_[index] = 1;
+      changed_keys_.push_back(index);
+    }
+    keys_[index] = key;
+  }
+  void init_fade();
+  void update_image_state(uint32_t now);
+  bool spawn_drop(int x, uint32_t now, bool is_image_drop = false);
+  void retire_drop(int id);
+  void on_timer(int id, uint32_t now);
+  void advance_drop(int id, uint32_t now);
+  void mark_dirty(int x) {
+    if (!columns_[x].dirty) {
+      columns_[x].dirty = true;
+      dirty_columns_.push_back(x);
+    }
+  }
+  void paint_dirty_columns(uint32_t last_paint);
+  void paint_column(int x, uint32_t last_paint);
+  uint8_t painted_glyph(Drop &drop, int i, int index) const;
+  bool covered_by_later(int id, int row) const;
+  const FadeRate &cell_fade_rate(int index) const;
+  void refresh_key(int index) { set_key(index, get_cell_key(index, last_update_)); }
+  void schedule_spawn(int x, uint32_t now, bool wait_interval);
+  void update_fade(uint32_t now);
+  void update_keys(uint32_t now);
+  void set_image_state(ImageRevealState state);
+  uint32_t get_cell_key(int index, uint32_t now) const;
+  bool is_screen_clear() const { return active_drops() == 0; }
+  bool on_screen(int row) const { return row >= 0 && row < rows_; }
+  void set_next_reveal_time(uint32_t now);
+  bool can_spawn() const {
+    return !spawn_held_ &&
+           (image_state_ == ImageRevealState::NORMAL || image_state_ == ImageRevealState::ERASING);
+  }
+
+  int advance_timer(int id) const { return id * 2; }
+  int mutate_timer(int id) const { return id * 2 + 1; }
+  int spawn_timer(int x) const { return drops_.size() * 2 + x; }
+
+  Cell &cell_at(int x, int y) { return cells_[y * cols_ + x]; }
+  const Cell &cell_at(int x, int y) const { return cells_[y * cols_ + x]; }
+  uint8_t random_glyph() { return rng_.uniform(glyph_set_->size); }
+
+  static FadeRate make_fade_rate(uint32_t duration_ms);
+  FadeRate make_image_fade_rate(uint8_t brightness) const;
+};
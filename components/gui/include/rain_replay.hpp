@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "rain_engine.hpp"
+
+/// @brief Scripted, reproducible run of a RainEngine.
+/// A script fixes everything the rain depends on: the grid, the parameters,
+/// the seed, the image and every tick of the clock. Replaying a script always
+/// produces the same frames, so the per-frame hashes of a replay can be
+/// stored as a golden sequence and compared after a change.
+class RainReplay {
+public:
+  /// A run of frames which all advance the clock by the same amount.
+  struct Segment {
+    int frames;        //< Number of frames in the segment
+    uint32_t frame_ms; //< Time between two frames of the segment
+  };
+
+  struct Script {
+    std::string name;
+    RainEngine::Config config;              //< config.clock is ignored, the script drives it
+    std::vector<uint8_t> image_brightness;  //< Brightness map to reveal, empty for none
+    uint8_t min_image_brightness = 0;       //< See RainEngine::set_min_image_brightness()
+    uint32_t start_tick = 0;                //< Clock value when the engine is created
+    std::vector<Segment> segments;          //< Tick sequence, one update per frame
+  };
+
+  /// The outcome of one update of the replay.
+  struct Frame {
+    uint32_t tick; //< Clock value of the update
+    uint64_t hash; //< RainEngine::frame_hash() after the update
+  };
+
+  /// @brief Runs a script from the start.
+  /// @param script The script to replay.
+  /// @return The tick and hash of every frame of the script.
+  static std::vector<Frame> run(const Script &script) {
+    uint32_t now = script.start_tick;
+    RainEngine::Config config = script.config;
+    config.clock = [&now] { return now; };
+    RainEngine engine(config);
+    engine.set_min_image_brightness(script.min_image_brightness);
+    if (!script.image_brightness.empty()) {
+      engine.set_image_brightness(script.image_brightness);
+    }
+
+    std::vector<Frame> frames;
+    for (const auto &segment : script.segments) {
+      for (int i = 0; i < segment.frames; ++i) {
+        now += segment.frame_ms;
+        engine.update();
+        frames.push_back({now, engine.frame_hash()});
+      }
+    }
+    return frames;
+  }
+};
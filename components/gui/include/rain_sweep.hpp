@@ -0,0 +1,256 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <fmt/core.h>
+
+#if __has_include("lvgl_private.h")
+#include "lvgl_private.h" // LV_INV_BUF_SIZE
+#endif
+
+#include "rain_engine.hpp"
+
+/// @brief Benchmark of the matrix rain across screen resolutions and font
+///        sizes.
+/// Each case sizes the grid and scales the rain's parameters the way
+/// Gui::init_ui() and MatrixRain::init() do for its screen and font, runs the
+/// engine on a simulated clock and measures what the rain costs there: the
+/// time to simulate a frame, the drops falling, the memory of the engine and
+/// of the renderers, and the bytes each renderer has LVGL flush per frame.
+/// It only depends on RainEngine, so the same sweep runs on a host
+/// (host/rain_sweep.cpp) and on the device (CONFIG_MRP_RAIN_BENCH_SWEEP).
+class RainSweep {
+public:
+  /// A font the rain could be drawn with.
+  struct Font {
+    const char *name;
+    int char_width;  //< Width of a cell in pixels
+    int char_height; //< Height of a glyph in pixels, Gui::init_ui() tunes the rain by it
+    int line_height; //< Height of a cell (the font's line height) in pixels
+    bool hypothetical; //< The firmware doesn't have this font
+  };
+
+  struct Case {
+    int screen_width;
+    int screen_height;
+    Font font;
+  };
+
+  struct Options {
+    int frames = 2000; //< Frames to simulate in each case
+    int frame_ms = 30; //< Simulated time between two frames
+    uint32_t seed = 1; //< Seed of the rain, the same in every case
+    int layers = 0;    //< Depth layers behind the rain, see RainEngine::depth_layers()
+  };
+
+  struct Result {
+    Case config;
+    int cols;
+    int rows;
+    float frame_us;           //< Average time to simulate a frame, without drawing it
+    float max_frame_us;       //< Longest time to simulate a frame, without drawing it
+    float drops_per_frame;    //< Average drops falling
+    int peak_drops;           //< Most drops falling at once
+    size_t engine_bytes;      //< Memory of the engine, see RainEngine::memory_bytes()
+    size_t cell_grid_bytes;   //< Estimated memory of the cell grid renderer
+    size_t framebuffer_bytes; //< Estimated memory of the framebuffer renderer, with its atlas
+    float cell_flush_bytes;   //< Estimated bytes flushed per frame by the cell grid renderer
+    float row_flush_bytes;    //< Estimated bytes flushed per frame by the row renderers
+  };
+
+  static constexpr int bytes_per_pixel = 2; //< RGB565
+  /// LVGL's default LV_INV_BUF_SIZE, for the host which builds without LVGL.
+  static constexpr int host_inv_buf_size = 32;
+#ifdef LV_INV_BUF_SIZE
+  static constexpr int inv_buf_size = LV_INV_BUF_SIZE;
+#else
+  static constexpr int inv_buf_size = host_inv_buf_size;
+#endif
+  /// Areas CellGrid::invalidate_changed() invalidates at most.
+  static constexpr int max_cell_grid_areas = inv_buf_size / 2;
+
+  /// unscii_8_jp, and the same font scaled up twice, a hypothetical larger
+  /// font to see how the rain scales with the cell size.
+  static constexpr Font fonts[] = {
+      {"unscii_8_jp", 8, 8, 15, false},
+      {"unscii_8_jp x2", 16, 16, 30, true},
+  };
+  /// The Byte90, the Waveshare ESP32-S3 TouchLCD and larger panels.
+  static constexpr int resolutions[][2] = {{128, 128}, {240, 240}, {320, 240}, {480, 320}};
+
+  /// @brief Returns every resolution with every font.
+  static std::vector<Case> default_cases() {
+    std::vector<Case> cases;
+    for (const auto &resolution : resolutions) {
+      for (const auto &font : fonts) {
+        cases.push_back({resolution[0], resolution[1], font});
+      }
+    }
+    return cases;
+  }
+
+  /// @brief Runs the rain of one case.
+  static Result run(const Case &sweep_case, const Options &options) {
+    const Font &font = sweep_case.font;
+    Result result{};
+    result.config = sweep_case;
+    result.cols = std::max(sweep_case.screen_width / font.char_width, 1);
+    result.rows = std::max((sweep_case.screen_height + font.line_height - 1) / font.line_height, 1);
+    const int num_cells = result.cols * result.rows;
+
+    uint32_t now = 0;
+    RainEngine::Config config;
+    static_cast<RainEngine::Params &>(config) =
+        RainEngine::scaled_params(sweep_case.screen_height / font.char_height);
+    config.frame_interval_ms = options.frame_ms;
+    config.layers = RainEngine::depth_layers(config, options.layers);
+    config.seed = options.seed;
+    config.cols = result.cols;
+    config.rows = result.rows;
+    config.clock = [&now] { return now; };
+    RainEngine engine(config);
+
+    std::vector<uint32_t> previous(num_cells, 0);
+    std::vector<uint8_t> changed(num_cells, 0);
+    double total_us = 0;
+    double total_drops = 0;
+    double total_cell_flush = 0;
+    double total_row_flush = 0;
+    for (int frame = 0; frame < options.frames; ++frame) {
+      now += options.frame_ms;
+      auto start = std::chrono::steady_clock::now();
+      engine.update();
+      float us = std::chrono::duration<float, std::micro>(std::chrono::steady_clock::now() - start)
+                     .count();
+      total_us += us;
+      result.max_frame_us = std::max(result.max_frame_us, us);
+      int drops = engine.stats().active_drops;
+      total_drops += drops;
+      result.peak_drops = std::max(result.peak_drops, drops);
+
+      const uint32_t *keys = engine.keys();
+      for (int i = 0; i < num_cells; ++i) {
+        changed[i] = keys[i] != previous[i];
+      }
+      std::copy_n(keys, num_cells, previous.begin());
+      total_cell_flush += cell_flush_bytes(result, changed);
+      total_row_flush += row_flush_bytes(result, changed);
+    }
+    const int frames = std::max(options.frames, 1);
+    result.frame_us = total_us / frames;
+    result.drops_per_frame = total_drops / frames;
+    result.cell_flush_bytes = total_cell_flush / frames;
+    result.row_flush_bytes = total_row_flush / frames;
+
+    // What MatrixRain allocates besides the engine: the keys of each cell,
+    // and the frames handed over by the simulation task
+    const size_t frame_bytes = num_cells * sizeof(uint32_t);
+    const size_t rain_bytes = frame_bytes + 3 * frame_bytes;
+    result.engine_bytes = engine.memory_bytes();
+    const GlyphSet &glyph_set = engine.glyph_set();
+    // CellGrid: the keys and their change flags. The UTF-8 of the glyphs is
+    // the glyph set's, in flash.
+    result.cell_grid_bytes = rain_bytes + num_cells * (sizeof(uint32_t) + 1) + result.rows;
+    // The screen-sized canvas and the glyph atlas, a tile per glyph and color
+    size_t tile_bytes = font.char_width * font.line_height * bytes_per_pixel;
+    result.framebuffer_bytes =
+        rain_bytes + sweep_case.screen_width * sweep_case.screen_height * bytes_per_pixel +
+        glyph_set.size * (2 + config.fade_levels) * tile_bytes;
+    return result;
+  }
+
+  /// @brief Returns the header of the table format() prints rows of, after
+  ///        a line which explains its marks.
+  static std::string header() {
+    return "sim: simulation only, nothing is drawn; ~: estimated from the renderers' "
+           "buffers and invalidated areas; *: hypothetical font\n" +
+           fmt::format("{:>7} {:<15} {:>7} {:>9} {:>9} {:>8} {:>9} {:>9} {:>9} {:>10} {:>10}",
+                       "screen", "font", "grid", "sim us/fr", "sim max", "drops", "engine KB",
+                       "~grid KB", "~fb KB", "~grid B/fr", "~rows B/fr");
+  }
+
+  /// @brief Returns a row of the table of results.
+  static std::string format(const Result &result) {
+    const Case &c = result.config;
+    return fmt::format(
+        "{:>7} {:<15} {:>7} {:>9.1f} {:>9.1f} {:>8.1f} {:>9.1f} {:>9.1f} {:>9.1f} {:>10.0f} "
+        "{:>10.0f}",
+        fmt::format("{}x{}", c.screen_width, c.screen_height),
+        fmt::format("{}{}", c.font.name, c.font.hypothetical ? "*" : ""),
+        fmt::format("{}x{}", result.cols, result.rows), result.frame_us, result.max_frame_us,
+        result.drops_per_frame, result.engine_bytes / 1024.0f, result.cell_grid_bytes / 1024.0f,
+        result.framebuffer_bytes / 1024.0f, result.cell_flush_bytes, result.row_flush_bytes);
+  }
+
+protected:
+  /// Pixels of a row of cells which are on the screen; the last row may be
+  /// cut off by the bottom of the screen.
+  static int row_height(const Result &result, int y) {
+    const int line_height = result.config.font.line_height;
+    return std::min(line_height, result.config.screen_height - y * line_height);
+  }
+
+  /// Bytes of the areas CellGrid::invalidate_changed() invalidates: each run
+  /// of changed cells, or the changed span of each row if there are too many
+  /// runs, or the box around every change if there are too many rows.
+  static size_t cell_flush_bytes(const Result &result, const std::vector<uint8_t> &changed) {
+    const int cols = result.cols;
+    const int cell_width = result.config.font.char_width;
+    int num_runs = 0;
+    int num_rows = 0;
+    size_t run_pixels = 0;
+    size_t span_pixels = 0;
+    int top = -1;
+    int bottom = -1;
+    int left = cols;
+    int right = -1;
+    for (int y = 0; y < result.rows; ++y) {
+      const uint8_t *row = &changed[y * cols];
+      int first = -1;
+      int last = -1;
+      for (int x = 0; x < cols; ++x) {
+        if (!row[x])
+          continue;
+        num_runs += x == 0 || !row[x - 1];
+        run_pixels += cell_width * row_height(result, y);
+        if (first < 0)
+          first = x;
+        last = x;
+      }
+      if (first < 0)
+        continue;
+      num_rows++;
+      span_pixels += (last - first + 1) * cell_width * row_height(result, y);
+      if (top < 0)
+        top = y;
+      bottom = y;
+      left = std::min(left, first);
+      right = std::max(right, last);
+    }
+    if (num_runs <= max_cell_grid_areas)
+      return run_pixels * bytes_per_pixel;
+    if (num_rows <= max_cell_grid_areas)
+      return span_pixels * bytes_per_pixel;
+    int box_height = 0;
+    for (int y = top; y <= bottom; ++y) {
+      box_height += row_height(result, y);
+    }
+    return (size_t)(right - left + 1) * cell_width * box_height * bytes_per_pixel;
+  }
+
+  /// Bytes of the rows which changed, which the label and framebuffer
+  /// renderers invalidate across the whole width of the screen.
+  static size_t row_flush_bytes(const Result &result, const std::vector<uint8_t> &changed) {
+    size_t pixels = 0;
+    for (int y = 0; y < result.rows; ++y) {
+      auto row = changed.begin() + y * result.cols;
+      if (std::find(row, row + result.cols, 1) != row + result.cols)
+        pixels += result.config.screen_width * row_height(result, y);
+    }
+    return pixels * bytes_per_pixel;
+  }
+};
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/// @brief Small, fast pseudo random number generator (xorshift32).
+/// Each owner keeps its own instance, so sequences are reproducible from the
+/// seed and independent of any other users of random numbers.
+class Rng {
+public:
+  /// @brief Constructor for the random number generator.
+  /// @param seed The seed to start the sequence from. Any value (including 0)
+  ///             is valid.
+  explicit Rng(uint32_t seed = 0) { set_seed(seed); }
+
+  /// @brief Restarts the sequence from the given seed.
+  /// @param seed The seed to start the sequence from.
+  void set_seed(uint32_t seed) {
+    // Mix the seed (splitmix32) so that similar seeds give unrelated
+    // sequences, and so the state is never 0, which xorshift can't leave.
+    seed += 0x9E3779B9;
+    seed = (seed ^ (seed >> 16)) * 0x85EBCA6B;
+    seed = (seed ^ (seed >> 13)) * 0xC2B2AE35;
+    seed ^= seed >> 16;
+    state_ = seed ? seed : 0x6D2B79F5;
+  }
+
+  /// @brief Returns the next 32 bit random number.
+  uint32_t next() {
+    uint32_t x = state_;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    state_ = x;
+    return x;
+  }
+
+  /// @brief Returns a random number in [0, n).
+  /// @param n The exclusive upper bound, must be > 0.
+  /// @note Uses a multiply and shift instead of a modulo, which is much faster
+  ///       on the ESP32 and has negligible bias for small n.
+  uint32_t uniform(uint32_t n) { return ((uint64_t)next() * n) >> 32; }
+
+  /// @brief Returns a random number in [min, max].
+  int range(int min, int max) { return min + (int)uniform(max - min + 1); }
+
+  /// @brief Fills a buffer with random numbers in [0, n).
+  /// @param out The buffer to fill.
+  /// @param count The number of values to write.
+  /// @param n The exclusive upper bound of each value, must be > 0 and <= 256.
+  void fill(uint8_t *out, size_t count, uint32_t n) {
+    uint32_t x = state_;
+    for (size_t i = 0; i < count; ++i) {
+      x ^= x << 13;
+      x ^= x >> 17;
+      x ^= x << 5;
+      out[i] = ((uint64_t)x * n) >> 32;
+    }
+    state_ = x;
+  }
+
+protected:
+  uint32_t state_{0};
+};
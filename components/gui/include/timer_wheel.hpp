@@ -0,0 +1,114 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/// @brief Hashed timer wheel for scheduling many small timers by id.
+/// Timers are identified by an integer id in [0, capacity) and are kept in
+/// intrusive lists, one per wheel slot, so scheduling, cancelling and firing
+/// are O(1) and never allocate after init(). Advancing the wheel only visits
+/// the slots between the last advance and now, so its cost follows the number
+/// of timers that are (nearly) due rather than the number of timers.
+class TimerWheel {
+public:
+  static constexpr int slot_shift = 2;    //< Each slot covers 1 << slot_shift ms
+  static constexpr uint32_t num_slots = 256; //< Must be a power of two
+  static constexpr uint32_t slot_mask = num_slots - 1;
+
+  /// @brief Resets the wheel, dropping all timers.
+  /// @param capacity The number of timer ids, valid ids are [0, capacity).
+  /// @param now The current time in ms.
+  void init(size_t capacity, uint32_t now) {
+    nodes_.assign(capacity, Node{});
+    nodes_.shrink_to_fit();
+    slots_.assign(num_slots, -1);
+    due_.clear();
+    due_.shrink_to_fit();
+    due_.reserve(capacity);
+    next_tick_ = now >> slot_shift;
+  }
+
+  /// @brief Schedules (or reschedules) a timer.
+  /// @param id The id of the timer.
+  /// @param due The time in ms at which the timer is due.
+  void schedule(int id, uint32_t due) {
+    cancel(id);
+    // Timers which are already due go in the first slot that will be visited
+    uint32_t tick = due >> slot_shift;
+    if ((int32_t)(tick - next_tick_) < 0)
+      tick = next_tick_;
+    auto &node = nodes_[id];
+    node.due = due;
+    node.slot = tick & slot_mask;
+    node.prev = -1;
+    node.next = slots_[node.slot];
+    if (node.next != -1)
+      nodes_[node.next].prev = id;
+    slots_[node.slot] = id;
+  }
+
+  /// @brief Cancels a timer, if it is scheduled.
+  /// @param id The id of the timer.
+  void cancel(int id) {
+    auto &node = nodes_[id];
+    if (node.slot < 0)
+      return;
+    if (node.prev != -1)
+      nodes_[node.prev].next = node.next;
+    else
+      slots_[node.slot] = node.next;
+    if (node.next != -1)
+      nodes_[node.next].prev = node.prev;
+    node.slot = -1;
+  }
+
+  /// @brief Returns true if the timer is scheduled.
+  bool is_scheduled(int id) const { return nodes_[id].slot >= 0; }
+
+  /// @brief Fires every timer which is due at or before now.
+  /// Due timers are removed from the wheel before any callback runs, so the
+  /// callback is free to schedule or cancel any timer, including the one that
+  /// fired.
+  /// @param now The current time in ms.
+  /// @param on_due Called with the id of each timer that is due.
+  template <typename F> void advance(uint32_t now, F &&on_due) {
+    uint32_t end_tick = now >> slot_shift;
+    // After a long gap every slot has to be visited, but only once
+    uint32_t num_ticks = std::min<uint32_t>(end_tick - next_tick_, num_slots - 1) + 1;
+    due_.clear();
+    for (uint32_t i = 0; i < num_ticks; ++i) {
+      uint32_t slot = (next_tick_ + i) & slot_mask;
+      for (int id = slots_[slot]; id != -1; id = nodes_[id].next) {
+        if ((int32_t)(nodes_[id].due - now) <= 0)
+          due_.push_back(id);
+      }
+    }
+    for (int id : due_)
+      cancel(id);
+    // Timers may still be added to the current slot which are due later in
+    // this same tick, so it is visited again on the next advance.
+    next_tick_ = end_tick;
+    for (int id : due_)
+      on_due(id);
+  }
+
+  /// @brief Returns the heap memory of the wheel in bytes.
+  size_t memory_bytes() const {
+    return nodes_.capacity() * sizeof(Node) + (slots_.capacity() + due_.capacity()) * sizeof(int);
+  }
+
+protected:
+  struct Node {
+    uint32_t due{0};
+    int slot{-1}; //< Slot the timer is in, -1 if it is not scheduled
+    int prev{-1};
+    int next{-1};
+  };
+
+  std::vector<Node> nodes_;
+  std::vector<int> slots_; //< Id of the first timer in each slot, -1 if empty
+  std::vector<int> due_;   //< Scratch list of the timers firing in advance()
+  uint32_t next_tick_{0};  //< First tick (time >> slot_shift) to visit in advance()
+};
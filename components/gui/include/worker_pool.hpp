@@ -0,0 +1,65 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "task.hpp"
+
+/// @brief Small pool of worker tasks for splitting a range of work (e.g. the
+///        rows of a frame) across cores.
+/// run() hands chunks of the range out to the workers and to the calling
+/// task, and returns once every chunk is done, so the caller can use the
+/// results right away (e.g. to flush the rows).
+class WorkerPool {
+public:
+  /// The function to run on a chunk [begin, end) of the range.
+  typedef std::function<void(int begin, int end)> chunk_fn;
+
+  struct Config {
+    int num_workers = 1;          //< Number of worker tasks, besides the calling task
+    size_t stack_size_bytes = 4096; //< Stack size of each worker task
+    size_t priority = 10;           //< Priority of the worker tasks
+    std::vector<int> core_ids;      //< Core to pin each worker to, -1 or missing for no affinity
+  };
+
+  /// @brief Constructor for the WorkerPool, starts the worker tasks.
+  /// @param config Configuration of the pool.
+  explicit WorkerPool(const Config &config);
+  /// @brief Destructor for the WorkerPool, stops the worker tasks.
+  ~WorkerPool();
+
+  /// @brief Number of worker tasks, besides the calling task.
+  int num_workers() const { return workers_.size(); }
+
+  /// @brief Runs a function over the range [0, count) and waits for it to
+  ///        finish.
+  /// @param count The size of the range.
+  /// @param chunk_size The number of items in each chunk handed out.
+  /// @param fn Called with each chunk, from the workers and the calling task
+  ///        at the same time. Chunks never overlap.
+  void run(int count, int chunk_size, const chunk_fn &fn);
+
+protected:
+  bool work(size_t worker, std::mutex &m, std::condition_variable &cv);
+  void run_chunks();
+
+  std::vector<std::unique_ptr<espp::Task>> workers_;
+  std::vector<uint32_t> seen_generation_; // last job generation each worker picked up
+
+  std::mutex job_mutex_;
+  std::condition_variable job_cv_;  // a new job was posted, or the pool is stopping
+  std::condition_variable done_cv_; // a worker finished its part of the job
+  uint32_t job_generation_{0};
+  int busy_workers_{0};
+  bool stopping_{false};
+
+  const chunk_fn *job_fn_{nullptr};
+  int job_count_{0};
+  int job_chunk_size_{1};
+  std::atomic<int> next_item_{0}; // first item of the next chunk to hand out
+};
@@ -0,0 +1,73 @@
+#include "asset_index.hpp"
+
+#include <fstream>
+#include <sstream>
+
+#include <fmt/core.h>
+
+static const char *kind_name(AssetIndex::Kind kind) {
+  switch (kind) {
+  case AssetIndex::Kind::IMAGE:
+    return "image";
+  case AssetIndex::Kind::BMAP:
+    return "bmap";
+  case AssetIndex::Kind::BMSEQ:
+    return "bmseq";
+  }
+  return "";
+}
+
+bool AssetIndex::load(const std::filesystem::path &file) {
+  entries_.clear();
+  std::ifstream stream(file);
+  if (!stream.is_open()) {
+    return false;
+  }
+  std::string line;
+  while (std::getline(stream, line)) {
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+    std::istringstream fields(line);
+    std::string kind;
+    Entry entry;
+    fields >> kind >> entry.name >> entry.file >> entry.width >> entry.height >> std::hex >>
+        entry.source_hash;
+    if (!fields) {
+      fmt::print("Malformed asset index line: '{}'\n", line);
+      entries_.clear();
+      return false;
+    }
+    if (kind == kind_name(Kind::IMAGE)) {
+      entry.kind = Kind::IMAGE;
+    } else if (kind == kind_name(Kind::BMAP)) {
+      entry.kind = Kind::BMAP;
+    } else if (kind == kind_name(Kind::BMSEQ)) {
+      entry.kind = Kind::BMSEQ;
+    } else {
+      // Newer kinds of assets are skipped, not an error
+      continue;
+    }
+    entries_.push_back(entry);
+  }
+  return true;
+}
+
+bool AssetIndex::save(const std::filesystem::path &file) const {
+  std::ofstream stream(file, std::ios::trunc);
+  stream << "# kind name file width height source_hash\n";
+  for (const auto &entry : entries_) {
+    stream << fmt::format("{} {} {} {} {} {:016x}\n", kind_name(entry.kind), entry.name,
+                          entry.file, entry.width, entry.height, entry.source_hash);
+  }
+  return (bool)stream;
+}
+
+const AssetIndex::Entry *AssetIndex::find(Kind kind, const std::string &name) const {
+  for (const auto &entry : entries_) {
+    if (entry.kind == kind && entry.name == name) {
+      return &entry;
+    }
+  }
+  return nullptr;
+}
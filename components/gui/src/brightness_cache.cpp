@@ -0,0 +1,117 @@
+#include "brightness_cache.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <system_error>
+
+#include <fmt/core.h>
+
+// An entry is a header followed by the cols x rows map:
+//   magic[4], version, format, cols (u16), rows (u16), source_hash (u64)
+// Every field is written byte by byte in little endian order, so an entry
+// written on a host reads back the same on the device.
+namespace {
+constexpr size_t header_size = 4 + 1 + 1 + 2 + 2 + 8;
+
+void put_le(uint8_t *out, uint64_t value, int num_bytes) {
+  for (int i = 0; i < num_bytes; ++i) {
+    out[i] = value >> (8 * i);
+  }
+}
+
+uint64_t get_le(const uint8_t *in, int num_bytes) {
+  uint64_t value = 0;
+  for (int i = 0; i < num_bytes; ++i) {
+    value |= (uint64_t)in[i] << (8 * i);
+  }
+  return value;
+}
+} // namespace
+
+uint64_t BrightnessCache::hash_file(const std::filesystem::path &file) {
+  std::ifstream stream(file, std::ios::binary);
+  if (!stream.is_open()) {
+    return 0;
+  }
+  uint64_t hash = 0xCBF29CE484222325;
+  char buffer[512];
+  while (stream) {
+    stream.read(buffer, sizeof(buffer));
+    for (std::streamsize i = 0; i < stream.gcount(); ++i) {
+      hash ^= (uint8_t)buffer[i];
+      hash *= 0x100000001B3;
+    }
+  }
+  return hash;
+}
+
+std::filesystem::path BrightnessCache::path_for(const Key &key) const {
+  return dir_ / fmt::format("{:016x}-{}x{}-{}.bmap", key.source_hash, key.cols, key.rows,
+                            key.format);
+}
+
+bool BrightnessCache::load(const Key &key, std::vector<uint8_t> &brightness_map) const {
+  std::ifstream stream(path_for(key), std::ios::binary);
+  if (!stream.is_open()) {
+    return false;
+  }
+  uint8_t bytes[header_size];
+  if (!stream.read((char *)bytes, header_size)) {
+    return false;
+  }
+  // The name could collide (or the file be stale), so check the whole key
+  if (memcmp(bytes, magic, 4) != 0 || bytes[4] != version || bytes[5] != key.format ||
+      get_le(&bytes[6], 2) != key.cols || get_le(&bytes[8], 2) != key.rows ||
+      get_le(&bytes[10], 8) != key.source_hash) {
+    return false;
+  }
+  brightness_map.resize(key.cols * key.rows);
+  if (!stream.read((char *)brightness_map.data(), brightness_map.size())) {
+    brightness_map.clear();
+    return false;
+  }
+  return true;
+}
+
+bool BrightnessCache::store(const Key &key, const std::vector<uint8_t> &brightness_map) const {
+  if (brightness_map.size() != (size_t)key.cols * key.rows) {
+    return false;
+  }
+  std::error_code ec;
+  std::filesystem::create_directories(dir_, ec);
+  if (ec) {
+    fmt::print("Couldn't create brightness cache directory {}: {}\n", dir_.string(),
+               ec.message());
+    return false;
+  }
+
+  uint8_t bytes[header_size];
+  memcpy(bytes, magic, 4);
+  bytes[4] = version;
+  bytes[5] = key.format;
+  put_le(&bytes[6], key.cols, 2);
+  put_le(&bytes[8], key.rows, 2);
+  put_le(&bytes[10], key.source_hash, 8);
+
+  auto path = path_for(key);
+  auto tmp_path = path;
+  tmp_path += ".tmp";
+  {
+    std::ofstream stream(tmp_path, std::ios::binary | std::ios::trunc);
+    stream.write((const char *)bytes, header_size);
+    stream.write((const char *)brightness_map.data(), brightness_map.size());
+    if (!stream) {
+      fmt::print("Couldn't write brightness cache entry {}\n", tmp_path.string());
+      stream.close();
+      std::filesystem::remove(tmp_path, ec);
+      return false;
+    }
+  }
+  std::filesystem::rename(tmp_path, path, ec);
+  if (ec) {
+    fmt::print("Couldn't store brightness cache entry {}: {}\n", path.string(), ec.message());
+    std::filesystem::remove(tmp_path, ec);
+    return false;
+  }
+  return true;
+}
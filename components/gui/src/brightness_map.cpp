@@ -0,0 +1,242 @@
+#include "brightness_map.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+// Brightness of one RGB565 pixel, each channel expanded to 8 bits first
+static inline uint8_t rgb565_luma(uint32_t pixel) {
+  uint32_t r5 = (pixel >> 11) & 0x1F;
+  uint32_t g6 = (pixel >> 5) & 0x3F;
+  uint32_t b5 = pixel & 0x1F;
+  return BrightnessMap::luma((r5 << 3) | (r5 >> 2), (g6 << 2) | (g6 >> 4), (b5 << 3) | (b5 >> 2));
+}
+
+#if defined(__XTENSA__)
+// Brightness of the two RGB565 pixels packed in a 32 bit word, one per 16
+// bit lane. Each step is the same as in rgb565_luma(), masked so that no lane
+// spills into the other: an 8 bit channel times its weight, and the sum of
+// the three, always fit in 16 bits.
+static inline uint32_t rgb565_luma2(uint32_t pixels) {
+  uint32_t r5 = (pixels >> 11) & 0x001F001F;
+  uint32_t g6 = (pixels >> 5) & 0x003F003F;
+  uint32_t b5 = pixels & 0x001F001F;
+  uint32_t r8 = (r5 << 3) | ((r5 >> 2) & 0x00070007);
+  uint32_t g8 = (g6 << 2) | ((g6 >> 4) & 0x00030003);
+  uint32_t b8 = (b5 << 3) | ((b5 >> 2) & 0x00070007);
+  return ((r8 * 77 + g8 * 151 + b8 * 28) >> 8) & 0x00FF00FF;
+}
+
+static inline uint32_t swap_bytes2(uint32_t pixels) {
+  return ((pixels & 0x00FF00FF) << 8) | ((pixels >> 8) & 0x00FF00FF);
+}
+
+// Runs rgb565_luma2() over a row, one word (two pixels) at a time
+template <bool swapped>
+static void rgb565_row_swar(const uint8_t *src, int width, uint8_t *luma) {
+  auto pixels = reinterpret_cast<const uint16_t *>(src);
+  int x = 0;
+  if (width > 0 && (reinterpret_cast<uintptr_t>(pixels) & 0x3)) {
+    // Get to a word boundary first
+    uint32_t pixel = pixels[0];
+    luma[x++] = rgb565_luma(swapped ? swap_bytes2(pixel) : pixel);
+  }
+  auto words = reinterpret_cast<const uint32_t *>(pixels + x);
+  for (; x + 1 < width; x += 2) {
+    uint32_t word = *words++;
+    uint32_t two = rgb565_luma2(swapped ? swap_bytes2(word) : word);
+    luma[x] = two;
+    luma[x + 1] = two >> 16;
+  }
+  if (x < width) {
+    uint32_t pixel = pixels[x];
+    luma[x] = rgb565_luma(swapped ? swap_bytes2(pixel) : pixel);
+  }
+}
+#endif
+
+size_t BrightnessMap::packed_stride(Format format, int width) {
+  switch (format) {
+  case Format::RGB565:
+  case Format::RGB565_SWAPPED:
+    return width * 2;
+  case Format::RGB888:
+    return width * 3;
+  case Format::ARGB8888:
+  case Format::XRGB8888:
+    return width * 4;
+  case Format::L8:
+  case Format::I8:
+    return width;
+  case Format::I1:
+    return (width + 7) / 8;
+  case Format::I2:
+    return (width + 3) / 4;
+  case Format::I4:
+    return (width + 1) / 2;
+  }
+  return 0;
+}
+
+BrightnessMap::row_kernel BrightnessMap::select_kernel(Format format) {
+  switch (format) {
+  case Format::RGB565:
+    return &rgb565_row;
+  case Format::RGB565_SWAPPED:
+    return &rgb565_swapped_row;
+  case Format::RGB888:
+    return &rgb888_row;
+  case Format::ARGB8888:
+    return &argb8888_row;
+  case Format::XRGB8888:
+    return &xrgb8888_row;
+  case Format::L8:
+    return &l8_row;
+  case Format::I1:
+    return &indexed_row<1>;
+  case Format::I2:
+    return &indexed_row<2>;
+  case Format::I4:
+    return &indexed_row<4>;
+  case Format::I8:
+    return &indexed_row<8>;
+  }
+  return nullptr;
+}
+
+bool BrightnessMap::compute(const Image &image, int cols, int rows, uint8_t *brightness_map) {
+  if (cols <= 0 || rows <= 0) {
+    return false;
+  }
+  std::fill_n(brightness_map, cols * rows, 0);
+  row_kernel kernel = select_kernel(image.format);
+  int num_palette_entries = 0;
+  switch (image.format) {
+  case Format::I1:
+    num_palette_entries = 2;
+    break;
+  case Format::I2:
+    num_palette_entries = 4;
+    break;
+  case Format::I4:
+    num_palette_entries = 16;
+    break;
+  case Format::I8:
+    num_palette_entries = 256;
+    break;
+  default:
+    break;
+  }
+  if (!kernel || !image.pixels || image.width <= 0 || image.height <= 0 ||
+      (num_palette_entries && !image.palette)) {
+    return false;
+  }
+  const size_t stride = image.stride ? image.stride : packed_stride(image.format, image.width);
+
+  // The brightness of an indexed pixel only depends on its palette entry
+  uint8_t palette_luma[256] = {};
+  for (int i = 0; i < num_palette_entries; ++i) {
+    const uint8_t *entry = &image.palette[i * 4];
+    palette_luma[i] = luma(entry[2], entry[1], entry[0]) * entry[3] / 255;
+  }
+
+  // Cell x covers source columns [x_bounds[x], x_bounds[x + 1]), and the same
+  // for rows. Neighboring cells share a bound, so every pixel is in at most
+  // one cell.
+  const float x_scale = (float)image.width / cols;
+  const float y_scale = (float)image.height / rows;
+  x_bounds_.resize(cols + 1);
+  y_bounds_.resize(rows + 1);
+  for (int x = 0; x <= cols; ++x) {
+    x_bounds_[x] = std::min<int>(x * x_scale, image.width);
+  }
+  for (int y = 0; y <= rows; ++y) {
+    y_bounds_[y] = std::min<int>(y * y_scale, image.height);
+  }
+
+  // Convert one source row at a time and add it up per source column, then
+  // add the columns up into the cells of the row. Both inner loops are plain
+  // element-wise loops, which the compiler can vectorize.
+  const int line_width = x_bounds_[cols];
+  line_.resize(line_width);
+  column_sums_.resize(line_width);
+  uint8_t *line = line_.data();
+  uint32_t *column_sums = column_sums_.data();
+  for (int y = 0; y < rows; ++y) {
+    std::fill_n(column_sums, line_width, 0);
+    for (int sy = y_bounds_[y]; sy < y_bounds_[y + 1]; ++sy) {
+      kernel(image.pixels + sy * stride, line_width, palette_luma, line);
+      for (int sx = 0; sx < line_width; ++sx) {
+        column_sums[sx] += line[sx];
+      }
+    }
+    const int cell_height = y_bounds_[y + 1] - y_bounds_[y];
+    for (int x = 0; x < cols; ++x) {
+      int count = (x_bounds_[x + 1] - x_bounds_[x]) * cell_height;
+      if (count <= 0)
+        continue;
+      uint32_t sum = 0;
+      for (int sx = x_bounds_[x]; sx < x_bounds_[x + 1]; ++sx) {
+        sum += column_sums[sx];
+      }
+      brightness_map[y * cols + x] = sum / count;
+    }
+  }
+  return true;
+}
+
+void BrightnessMap::rgb565_row(const uint8_t *src, int width, const uint8_t *, uint8_t *luma) {
+#if defined(__XTENSA__)
+  rgb565_row_swar<false>(src, width, luma);
+#else
+  auto pixels = reinterpret_cast<const uint16_t *>(src);
+  for (int x = 0; x < width; ++x) {
+    luma[x] = rgb565_luma(pixels[x]);
+  }
+#endif
+}
+
+void BrightnessMap::rgb565_swapped_row(const uint8_t *src, int width, const uint8_t *,
+                                       uint8_t *luma) {
+#if defined(__XTENSA__)
+  rgb565_row_swar<true>(src, width, luma);
+#else
+  for (int x = 0; x < width; ++x) {
+    luma[x] = rgb565_luma((src[2 * x] << 8) | src[2 * x + 1]);
+  }
+#endif
+}
+
+void BrightnessMap::rgb888_row(const uint8_t *src, int width, const uint8_t *, uint8_t *luma) {
+  for (int x = 0; x < width; ++x) {
+    luma[x] = BrightnessMap::luma(src[3 * x + 2], src[3 * x + 1], src[3 * x]);
+  }
+}
+
+void BrightnessMap::argb8888_row(const uint8_t *src, int width, const uint8_t *, uint8_t *luma) {
+  // Transparent pixels are black, and partially transparent pixels darker
+  for (int x = 0; x < width; ++x) {
+    uint32_t brightness = BrightnessMap::luma(src[4 * x + 2], src[4 * x + 1], src[4 * x]);
+    luma[x] = brightness * src[4 * x + 3] / 255;
+  }
+}
+
+void BrightnessMap::xrgb8888_row(const uint8_t *src, int width, const uint8_t *, uint8_t *luma) {
+  for (int x = 0; x < width; ++x) {
+    luma[x] = BrightnessMap::luma(src[4 * x + 2], src[4 * x + 1], src[4 * x]);
+  }
+}
+
+void BrightnessMap::l8_row(const uint8_t *src, int width, const uint8_t *, uint8_t *luma) {
+  memcpy(luma, src, width);
+}
+
+template <int bpp>
+void BrightnessMap::indexed_row(const uint8_t *src, int width, const uint8_t *palette_luma,
+                                uint8_t *luma) {
+  constexpr int pixels_per_byte = 8 / bpp;
+  constexpr uint32_t index_mask = (1 << bpp) - 1;
+  for (int x = 0; x < width; ++x) {
+    int shift = (pixels_per_byte - 1 - x % pixels_per_byte) * bpp;
+    luma[x] = palette_luma[(src[x / pixels_per_byte] >> shift) & index_mask];
+  }
+}
@@ -0,0 +1,101 @@
+#include "brightness_sequence.hpp"
+
+#include <cstring>
+
+namespace {
+void put_le16(uint8_t *out, uint16_t value) {
+  out[0] = value & 0xFF;
+  out[1] = value >> 8;
+}
+
+uint16_t get_le16(const uint8_t *in) { return in[0] | (in[1] << 8); }
+} // namespace
+
+bool BrightnessSequence::open(const std::filesystem::path &file) {
+  close();
+  stream_.open(file, std::ios::binary);
+  if (!stream_.is_open()) {
+    return false;
+  }
+  uint8_t bytes[header_size];
+  if (!stream_.read((char *)bytes, header_size) || memcmp(bytes, magic, 4) != 0 ||
+      bytes[4] != version) {
+    close();
+    return false;
+  }
+  header_.cols = get_le16(&bytes[6]);
+  header_.rows = get_le16(&bytes[8]);
+  header_.num_frames = get_le16(&bytes[10]);
+  header_.frame_interval_ms = get_le16(&bytes[12]);
+  if (frame_size() == 0 || header_.num_frames == 0) {
+    close();
+    return false;
+  }
+  frames_[0].assign(frame_size(), 0);
+  frames_[1].assign(frame_size(), 0);
+  // Read the first frame straight into the front buffer
+  if (!read_next() || !advance()) {
+    close();
+    return false;
+  }
+  return true;
+}
+
+void BrightnessSequence::close() {
+  if (stream_.is_open()) {
+    stream_.close();
+  }
+  stream_.clear();
+  header_ = {};
+  next_frame_ = 0;
+  frames_[0].clear();
+  frames_[1].clear();
+  front_ = 0;
+  back_ready_.store(false, std::memory_order_release);
+}
+
+bool BrightnessSequence::advance() {
+  if (!back_ready_.load(std::memory_order_acquire)) {
+    return false;
+  }
+  front_ = 1 - front_;
+  back_ready_.store(false, std::memory_order_release);
+  return true;
+}
+
+bool BrightnessSequence::read_next() {
+  if (!stream_.is_open() || !needs_frame()) {
+    return false;
+  }
+  if (next_frame_ >= header_.num_frames) {
+    next_frame_ = 0;
+    stream_.clear();
+    stream_.seekg(header_size);
+  }
+  auto &back = frames_[1 - front_];
+  if (!stream_.read((char *)back.data(), back.size())) {
+    return false;
+  }
+  next_frame_++;
+  back_ready_.store(true, std::memory_order_release);
+  return true;
+}
+
+bool BrightnessSequence::write(const std::filesystem::path &file, const Header &header,
+                               const std::vector<uint8_t> &frames) {
+  if (frames.size() != (size_t)header.num_frames * header.cols * header.rows ||
+      frames.empty()) {
+    return false;
+  }
+  uint8_t bytes[header_size] = {};
+  memcpy(bytes, magic, 4);
+  bytes[4] = version;
+  put_le16(&bytes[6], header.cols);
+  put_le16(&bytes[8], header.rows);
+  put_le16(&bytes[10], header.num_frames);
+  put_le16(&bytes[12], header.frame_interval_ms);
+  std::ofstream stream(file, std::ios::binary | std::ios::trunc);
+  stream.write((const char *)bytes, header_size);
+  stream.write((const char *)frames.data(), frames.size());
+  return (bool)stream;
+}
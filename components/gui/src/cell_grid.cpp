@@ -0,0 +1,187 @@
+#include "cell_grid.hpp"
+
+#include <algorithm>
+
+#include "rain_engine.hpp"
+
+CellGrid::CellGrid(const Config &config)
+    : config_(config) {
+  config_.cols = std::max(config_.cols, 1);
+  config_.rows = std::max(config_.rows, 1);
+  keys_.assign(config_.cols * config_.rows, 0);
+  changed_.assign(keys_.size(), 0);
+  row_changed_.assign(config_.rows, 0);
+  if (!config_.glyph_set)
+    config_.glyph_set = &katakana_glyph_set;
+}
+
+CellGrid::~CellGrid() { deinit(); }
+
+void CellGrid::init(lv_obj_t *parent) {
+  deinit();
+  obj_ = lv_obj_create(parent);
+  // A plain object: no background, border, padding, scrolling or input
+  lv_obj_remove_style_all(obj_);
+  lv_obj_clear_flag(obj_, LV_OBJ_FLAG_CLICKABLE);
+  lv_obj_clear_flag(obj_, LV_OBJ_FLAG_SCROLLABLE);
+  lv_obj_set_size(obj_, config_.cols * config_.cell_width, config_.rows * config_.cell_height);
+  lv_obj_set_pos(obj_, 0, 0);
+  if (config_.font)
+    lv_obj_set_style_text_font(obj_, config_.font, 0);
+  lv_obj_add_event_cb(obj_, &CellGrid::draw_event_cb, LV_EVENT_DRAW_MAIN, this);
+  std::fill(keys_.begin(), keys_.end(), 0);
+  std::fill(changed_.begin(), changed_.end(), 0);
+  std::fill(row_changed_.begin(), row_changed_.end(), 0);
+}
+
+void CellGrid::deinit() {
+  if (obj_ && lv_obj_is_valid(obj_))
+    lv_obj_del(obj_);
+  obj_ = nullptr;
+}
+
+void CellGrid::set_font(const lv_font_t *font) {
+  config_.font = font;
+  if (obj_ && font) {
+    // This redraws the whole widget
+    lv_obj_set_style_text_font(obj_, font, 0);
+  }
+}
+
+bool CellGrid::update_row(int y, const uint32_t *row_keys) {
+  if (y < 0 || y >= config_.rows)
+    return false;
+  uint32_t *keys = &keys_[y * config_.cols];
+  uint8_t *changed = &changed_[y * config_.cols];
+  bool dirty = false;
+  for (int x = 0; x < config_.cols; ++x) {
+    if (row_keys[x] != keys[x]) {
+      keys[x] = row_keys[x];
+      changed[x] = 1;
+      dirty = true;
+    }
+  }
+  row_changed_[y] |= dirty;
+  return dirty;
+}
+
+void CellGrid::invalidate_changed() {
+  if (!obj_)
+    return;
+  // Count the runs of changed cells, to pick how finely to invalidate
+  int num_runs = 0;
+  int num_rows = 0;
+  for (int y = 0; y < config_.rows; ++y) {
+    if (!row_changed_[y])
+      continue;
+    num_rows++;
+    const uint8_t *changed = &changed_[y * config_.cols];
+    for (int x = 0; x < config_.cols; ++x) {
+      num_runs += changed[x] && (x == 0 || !changed[x - 1]);
+    }
+  }
+
+  int top = -1;
+  int bottom = -1;
+  int left = config_.cols;
+  int right = -1;
+  for (int y = 0; y < config_.rows; ++y) {
+    if (!row_changed_[y])
+      continue;
+    uint8_t *changed = &changed_[y * config_.cols];
+    // A changed row has at least one changed cell
+    int first = 0;
+    while (!changed[first])
+      first++;
+    int last = config_.cols - 1;
+    while (!changed[last])
+      last--;
+    if (num_runs <= max_areas) {
+      // Each run of changed cells
+      for (int x = first; x <= last;) {
+        int end = x;
+        while (end + 1 <= last && changed[end + 1])
+          end++;
+        invalidate_cells(y, x, end);
+        x = end + 1;
+        while (x <= last && !changed[x])
+          x++;
+      }
+    } else if (num_rows <= max_areas) {
+      // The changed span of each row
+      invalidate_cells(y, first, last);
+    }
+    if (top < 0)
+      top = y;
+    bottom = y;
+    left = std::min(left, first);
+    right = std::max(right, last);
+    std::fill(changed + first, changed + last + 1, 0);
+    row_changed_[y] = 0;
+  }
+  if (num_rows > max_areas) {
+    // The box around every change
+    lv_area_t coords;
+    lv_obj_get_coords(obj_, &coords);
+    lv_area_t area{
+        .x1 = coords.x1 + left * config_.cell_width,
+        .y1 = coords.y1 + top * config_.cell_height,
+        .x2 = coords.x1 + (right + 1) * config_.cell_width - 1,
+        .y2 = coords.y1 + (bottom + 1) * config_.cell_height - 1,
+    };
+    lv_obj_invalidate_area(obj_, &area);
+  }
+}
+
+void CellGrid::invalidate_cells(int y, int x1, int x2) {
+  lv_area_t coords;
+  lv_obj_get_coords(obj_, &coords);
+  lv_area_t area{
+      .x1 = coords.x1 + x1 * config_.cell_width,
+      .y1 = coords.y1 + y * config_.cell_height,
+      .x2 = coords.x1 + (x2 + 1) * config_.cell_width - 1,
+      .y2 = coords.y1 + (y + 1) * config_.cell_height - 1,
+  };
+  lv_obj_invalidate_area(obj_, &area);
+}
+
+void CellGrid::draw(lv_layer_t *layer) {
+  lv_area_t coords;
+  lv_obj_get_coords(obj_, &coords);
+  // Only the cells in the area being redrawn
+  lv_area_t clip;
+  if (!lv_area_intersect(&clip, &coords, &layer->_clip_area))
+    return;
+  const int x1 = (clip.x1 - coords.x1) / config_.cell_width;
+  const int x2 = std::min((clip.x2 - coords.x1) / config_.cell_width, config_.cols - 1);
+  const int y1 = (clip.y1 - coords.y1) / config_.cell_height;
+  const int y2 = std::min((clip.y2 - coords.y1) / config_.cell_height, config_.rows - 1);
+
+  lv_draw_label_dsc_t dsc;
+  lv_draw_label_dsc_init(&dsc);
+  dsc.font = lv_obj_get_style_text_font(obj_, LV_PART_MAIN);
+  for (int y = y1; y <= y2; ++y) {
+    for (int x = x1; x <= x2; ++x) {
+      uint32_t key = keys_[y * config_.cols + x];
+      // Blank cells are left empty
+      if (!key)
+        continue;
+      // lv_draw_label() keeps a pointer to the text until the glyph is drawn,
+      // and the glyph set's text lives as long as the program
+      dsc.text = config_.glyph_set->utf8[RainEngine::key_glyph(key)].data();
+      dsc.color = lv_color_hex(RainEngine::key_color(key));
+      lv_area_t cell{
+          .x1 = coords.x1 + x * config_.cell_width,
+          .y1 = coords.y1 + y * config_.cell_height,
+          .x2 = coords.x1 + (x + 1) * config_.cell_width - 1,
+          .y2 = coords.y1 + (y + 1) * config_.cell_height - 1,
+      };
+      lv_draw_label(layer, &dsc, &cell);
+    }
+  }
+}
+
+void CellGrid::draw_event_cb(lv_event_t *e) {
+  auto grid = static_cast<CellGrid *>(lv_event_get_user_data(e));
+  grid->draw(lv_event_get_layer(e));
+}
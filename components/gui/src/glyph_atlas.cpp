@@ -0,0 +1,88 @@
+#include "glyph_atlas.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+#include <lvgl.h>
+
+#include "esp_heap_caps.h"
+
+GlyphAtlas::GlyphAtlas(const Config &config)
+    : config_(config) {
+  config_.cell_width = std::max(config_.cell_width, 1);
+  config_.cell_height = std::max(config_.cell_height, 1);
+  config_.num_levels = std::clamp(config_.num_levels, 1, 255);
+  if (!config_.glyph_set)
+    config_.glyph_set = &katakana_glyph_set;
+  num_colors_ = 2 + config_.num_levels;
+  tile_size_ = config_.cell_width * config_.cell_height;
+  num_bytes_ = config_.glyph_set->size * num_colors_ * tile_size_ * sizeof(uint16_t);
+  // A fading key stores the green value of its level, which is one of these
+  // levels unless the rain uses a different number of levels (e.g. at a
+  // lower quality). Either way, use the nearest one.
+  const int levels = config_.num_levels;
+  for (int green = 0; green < 256; ++green) {
+    int level = std::clamp((green * levels + 127) / 255, 1, levels);
+    fade_colors_[green] = 1 + level;
+  }
+}
+
+GlyphAtlas::~GlyphAtlas() { free_tiles(); }
+
+void GlyphAtlas::free_tiles() {
+  if (tiles_) {
+    heap_caps_free(tiles_);
+    tiles_ = nullptr;
+  }
+  in_psram_ = false;
+}
+
+bool GlyphAtlas::build(const Glyph *glyphs) {
+  free_tiles();
+  // A large atlas would starve LVGL and the rest of the firmware of internal
+  // RAM, so it only goes to PSRAM
+  if (num_bytes_ > config_.internal_max_bytes) {
+    tiles_ = (uint16_t *)heap_caps_malloc(num_bytes_, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    in_psram_ = tiles_ != nullptr;
+  } else {
+    tiles_ = (uint16_t *)heap_caps_malloc(num_bytes_, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+  }
+  if (!tiles_) {
+    return false;
+  }
+
+  std::vector<uint16_t> colors(num_colors_);
+  colors[0] = lv_color_to_u16(lv_color_hex(RainEngine::head_color));
+  colors[1] = lv_color_to_u16(lv_color_hex(RainEngine::body_color));
+  for (int level = 1; level <= config_.num_levels; ++level) {
+    uint32_t green = level * 0xFF / config_.num_levels;
+    colors[1 + level] = lv_color_to_u16(lv_color_hex(green << 8));
+  }
+  uint16_t *tile = tiles_;
+  for (int i = 0; i < config_.glyph_set->size; ++i) {
+    for (int color = 0; color < num_colors_; ++color, tile += tile_size_) {
+      draw_tile(tile, glyphs[i], colors[color]);
+    }
+  }
+  return true;
+}
+
+void GlyphAtlas::draw_tile(uint16_t *tile, const Glyph &glyph, uint16_t color) const {
+  const int width = config_.cell_width;
+  const int height = config_.cell_height;
+  memset(tile, 0, tile_size_ * sizeof(uint16_t));
+  if (!glyph.bitmap)
+    return;
+  // Bits are packed MSB first and rows are not padded to a byte boundary
+  uint32_t bit = 0;
+  for (int gy = 0; gy < glyph.height; ++gy) {
+    int py = glyph.y + gy;
+    for (int gx = 0; gx < glyph.width; ++gx, ++bit) {
+      int px = glyph.x + gx;
+      if (px < 0 || px >= width || py < 0 || py >= height)
+        continue;
+      if (glyph.bitmap[bit >> 3] & (0x80 >> (bit & 0x7)))
+        tile[py * width + px] = color;
+    }
+  }
+}
@@ -7,6 +7,27 @@
 #include <functional>
 #include <lvgl.h>
 
+#include "esp_timer.h"
+#include "glyph_set.hpp"
+#include "sdkconfig.h"
+
+#if CONFIG_MRP_RAIN_GLYPH_SET_CUSTOM
+static constexpr char custom_glyph_text[] = CONFIG_MRP_RAIN_GLYPH_SET_CUSTOM_CHARS;
+static constexpr auto custom_glyphs =
+    make_glyph_table(utf8_codepoints<utf8_length(custom_glyph_text)>(custom_glyph_text));
+static_assert(glyphs_in_font(custom_glyphs),
+              "every glyph of CONFIG_MRP_RAIN_GLYPH_SET_CUSTOM_CHARS must be in unscii_8_jp");
+static constexpr GlyphSet rain_glyph_set = custom_glyphs.set("custom");
+#elif CONFIG_MRP_RAIN_GLYPH_SET_DIGITS
+static constexpr const GlyphSet &rain_glyph_set = digit_glyph_set;
+#elif CONFIG_MRP_RAIN_GLYPH_SET_BINARY
+static constexpr const GlyphSet &rain_glyph_set = binary_glyph_set;
+#elif CONFIG_MRP_RAIN_GLYPH_SET_HEX
+static constexpr const GlyphSet &rain_glyph_set = hex_glyph_set;
+#else
+static constexpr const GlyphSet &rain_glyph_set = katakana_glyph_set;
+#endif
+
 extern "C" {
 extern const lv_font_t unscii_8_jp;
 }
@@ -50,20 +71,21 @@ void Gui::init_ui() {
   // MatrixRain
   auto num_rows = screen_height / matrix_char_height_;
   MatrixRain::Config rain_cfg;
+  static_cast<RainEngine::Params &>(rain_cfg) = RainEngine::scaled_params(num_rows);
+  rain_cfg.layers = RainEngine::depth_layers(rain_cfg, CONFIG_MRP_RAIN_DEPTH_LAYERS);
+  rain_cfg.drop_budget = CONFIG_MRP_RAIN_DROP_BUDGET;
   rain_cfg.screen_width = screen_width;
   rain_cfg.screen_height = screen_height;
   rain_cfg.char_width = matrix_char_width_;
   rain_cfg.char_height = matrix_char_height_;
-  rain_cfg.drop_spawn_chance = std::max<int>(300 / num_rows, 20); // larger number = less chance
-  rain_cfg.min_drop_length = num_rows / 8;
-  rain_cfg.max_drop_length = num_rows / 3;
-  rain_cfg.min_speed_ms = std::max<int>(750 / num_rows, 50);
-  rain_cfg.speed_range_ms = std::max<int>(2000 / num_rows, 100) - rain_cfg.min_speed_ms;
-  rain_cfg.image_drop_speed_ms = std::max<int>(500 / num_rows, 25);
+  rain_cfg.frame_interval_ms = timer_interval_ms_;
+  rain_cfg.seed = seed_;
+  rain_cfg.glyph_set = &rain_glyph_set;
   matrix_rain_ = std::make_unique<MatrixRain>(rain_cfg);
   matrix_rain_->set_font(&unscii_8_jp);
   matrix_rain_->init(lv_screen_active());
   matrix_rain_->set_visible(false);
+  matrix_rain_->set_quality_level(quality_.level(), quality_.num_levels());
 }
 
 void Gui::on_value_changed(lv_event_t *e) {
@@ -104,6 +126,7 @@ void Gui::update() {
     return;
   std::lock_guard<std::recursive_mutex> lk(mutex_);
 
+  uint64_t frame_start_us = esp_timer_get_time();
   uint32_t now = lv_tick_get();
 
   switch (mode_) {
@@ -152,7 +175,7 @@ void Gui::update() {
           boot_->add_line(boot_anim.prefix);
         break;
       } else if (boot_anim.state == BootLineAnim::State::PAUSE_AFTER_COLON) {
-        uint32_t delay = 350 + (rand() % 300 - 150.0f);
+        uint32_t delay = 350 + rng_.uniform(300) - 150;
         if (now - boot_anim.last_update > delay) {
           // Show full line
           if (boot_)
@@ -177,7 +200,8 @@ void Gui::update() {
             boot_->add_line(line);
           boot_line_index_++;
           last_boot_line_time_ = now;
-          next_boot_line_time = now + boot_line_delay_ms_ + (rand() % 200 - 100.0f);
+          int jitter = (int)rng_.uniform(200) - 100;
+          next_boot_line_time = now + boot_line_delay_ms_ + jitter;
         }
       }
     } else {
@@ -214,6 +238,8 @@ void Gui::update() {
       if (now - terminal_start_time_ > terminal_duration_ms_ + 1000) {
         mode_ = Mode::MATRIX_RAIN;
         matrix_rain_start_time_ = now;
+        // Only the rain's own frames count towards its quality
+        quality_.restart();
         if (terminal_)
           terminal_->start_fade_out();
         if (matrix_rain_) {
@@ -227,12 +253,36 @@ void Gui::update() {
   case Mode::MATRIX_RAIN:
     if (matrix_rain_) {
       matrix_rain_->update();
+      // Once per second, the stats of a single frame are enough to follow the rain
+      if (now - last_rain_log_time_ >= 1000) {
+        last_rain_log_time_ = now;
+        auto stats = matrix_rain_->get_stats();
+        logger_.debug("Matrix rain: {} drops ({} image, {} in layers), {} fading cells, "
+                      "{} rows skipped, quality level {}/{}",
+                      stats.active_drops, stats.active_image_drops, stats.active_layer_drops,
+                      stats.fading_cells, stats.rows_skipped, quality_.level(),
+                      quality_.num_levels() - 1);
+      }
       // matrix_rain_->debug_show_image();
     }
     break;
   }
 
   lv_task_handler();
+
+  if (mode_ == Mode::MATRIX_RAIN) {
+    update_quality(esp_timer_get_time() - frame_start_us);
+  }
+}
+
+void Gui::update_quality(uint32_t frame_us) {
+  if (!adaptive_quality_ || !matrix_rain_)
+    return;
+  if (quality_.add_frame(frame_us)) {
+    logger_.info("Average frame time {} us, rain quality level now {}/{}",
+                 quality_.average_frame_us(), quality_.level(), quality_.num_levels() - 1);
+    matrix_rain_->set_quality_level(quality_.level(), quality_.num_levels());
+  }
 }
 
 void Gui::restart() {
@@ -243,6 +293,7 @@ void Gui::restart() {
   last_boot_line_time_ = 0;
   terminal_start_time_ = 0;
   matrix_rain_start_time_ = 0;
+  last_rain_log_time_ = 0;
   mode_ = Mode::BOOT;
   last_char_time_ = 0;
   // Re-init UI
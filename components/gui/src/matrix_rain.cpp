@@ -1,17 +1,85 @@
 #include "matrix_rain.hpp"
 #include <algorithm>
-#include <cstdlib>
+#include <array>
+#include <cmath>
 #include <cstring>
-#include <ctime>
 #include <fmt/core.h> // Added for fmt::format
 
+#include "esp_heap_caps.h"
+#include "esp_random.h"
+#include "sdkconfig.h"
+
+#if CONFIG_MRP_RAIN_RENDERER_FRAMEBUFFER
+static constexpr bool use_framebuffer_renderer = true;
+#else
+static constexpr bool use_framebuffer_renderer = false;
+#endif
+
+#if CONFIG_MRP_RAIN_RENDERER_CELLGRID
+static constexpr bool use_cell_grid_renderer = true;
+#else
+static constexpr bool use_cell_grid_renderer = false;
+#endif
+
+#if CONFIG_MRP_RAIN_GLYPH_ATLAS
+static constexpr bool use_glyph_atlas = true;
+#else
+static constexpr bool use_glyph_atlas = false;
+#endif
+
+#if CONFIG_MRP_RAIN_SIM_TASK
+static constexpr bool use_sim_task = true;
+static constexpr int sim_task_core = CONFIG_MRP_RAIN_SIM_TASK_CORE;
+#else
+static constexpr bool use_sim_task = false;
+static constexpr int sim_task_core = -1;
+#endif
+
+#if defined(CONFIG_MRP_RAIN_ROW_WORKERS)
+static constexpr int num_row_workers = CONFIG_MRP_RAIN_ROW_WORKERS;
+#else
+static constexpr int num_row_workers = 0;
+#endif
+
+// Pre-rendered label text (the color tags here, the glyphs' UTF-8 in their
+// GlyphSet), so that building a row is just a few memcpy calls.
+// Each visible cell is "<color tag><utf8>#", e.g. "#00FF00 ア#".
+using ColorTag = std::array<char, 8>;
+static constexpr size_t max_cell_text_size = sizeof(ColorTag) + 4 + 1;
+
+static constexpr ColorTag make_color_tag(uint32_t rgb) {
+  constexpr char hex[] = "0123456789ABCDEF";
+  ColorTag tag{'#'};
+  for (int i = 0; i < 6; ++i) {
+    tag[1 + i] = hex[(rgb >> (20 - 4 * i)) & 0xF];
+  }
+  tag[7] = ' ';
+  return tag;
+}
+
+static constexpr ColorTag head_tag = make_color_tag(RainEngine::head_color);
+static constexpr ColorTag body_tag = make_color_tag(RainEngine::body_color);
+// One tag for every green value a fading cell can have, whatever the number of fade levels
+static constexpr auto fade_tags = [] {
+  std::array<ColorTag, 256> tags{};
+  for (uint32_t green = 0; green < tags.size(); ++green) {
+    tags[green] = make_color_tag(green << 8);
+  }
+  return tags;
+}();
+
 MatrixRain::MatrixRain(const Config &config)
-    : config_(config) {
+    : seed_rng_(config.seed ? config.seed : esp_random())
+    , config_(config) {
   font_ = nullptr;
-  set_next_reveal_time();
+  if (!config_.glyph_set || config_.glyph_set->size <= 0)
+    config_.glyph_set = &katakana_glyph_set;
 }
 
-MatrixRain::~MatrixRain() { deinit(); }
+MatrixRain::~MatrixRain() {
+  deinit();
+  stop_sequence();
+}
 
 void MatrixRain::set_font(const lv_font_t *font) {
   font_ = font;
@@ -23,6 +91,12 @@ void MatrixRain::set_font(const lv_font_t *font) {
   if (prompt_label_) {
     lv_obj_set_style_text_font(prompt_label_, font_, 0);
   }
+  if (canvas_) {
+    build_glyph_cache();
+  }
+  if (cell_grid_) {
+    cell_grid_->set_font(font_);
+  }
 }
 
 void MatrixRain::set_visible(bool visible) {
@@ -34,6 +108,18 @@ void MatrixRain::set_visible(bool visible) {
         lv_obj_add_flag(label, LV_OBJ_FLAG_HIDDEN);
     }
   }
+  if (canvas_) {
+    if (visible)
+      lv_obj_clear_flag(canvas_, LV_OBJ_FLAG_HIDDEN);
+    else
+      lv_obj_add_flag(canvas_, LV_OBJ_FLAG_HIDDEN);
+  }
+  if (cell_grid_) {
+    if (visible)
+      lv_obj_clear_flag(cell_grid_->get_obj(), LV_OBJ_FLAG_HIDDEN);
+    else
+      lv_obj_add_flag(cell_grid_->get_obj(), LV_OBJ_FLAG_HIDDEN);
+  }
   if (prompt_label_) {
     if (visible)
       lv_obj_clear_flag(prompt_label_, LV_OBJ_FLAG_HIDDEN);
@@ -94,46 +180,147 @@ void MatrixRain::debug_show_image() {
 }
 
 void MatrixRain::set_image(const lv_img_dsc_t *img) {
+  stop_sequence();
   if (!img) {
     image_mode_ = false;
     image_brightness_map_.clear();
+    std::lock_guard<std::mutex> lk(engine_mutex_);
+    if (engine_)
+      engine_->set_image_brightness({});
     return;
   }
 
   image_mode_ = true;
   image_brightness_map_.assign(cols_ * rows_, 0);
+  // Images in a format which can't be read are all black, like empty ones
+  BrightnessMap::Image image;
+  if (get_brightness_image(img, image)) {
+    brightness_mapper_.compute(image, cols_, rows_, image_brightness_map_.data());
+  }
+  std::lock_guard<std::mutex> lk(engine_mutex_);
+  if (engine_)
+    engine_->set_image_brightness(image_brightness_map_);
+}
 
-  if (img->header.w == 0 || img->header.h == 0) {
-    return;
+bool MatrixRain::set_image_brightness_map(std::vector<uint8_t> brightness_map) {
+  if (cols_ <= 0 || brightness_map.size() != (size_t)(cols_ * rows_)) {
+    return false;
   }
+  stop_sequence();
+  image_mode_ = true;
+  image_brightness_map_ = std::move(brightness_map);
+  std::lock_guard<std::mutex> lk(engine_mutex_);
+  if (engine_)
+    engine_->set_image_brightness(image_brightness_map_);
+  return true;
+}
 
-  // Use floating-point for more accurate scaling
-  float x_scale = (float)img->header.w / cols_;
-  float y_scale = (float)img->header.h / rows_;
+bool MatrixRain::set_image_sequence(const std::filesystem::path &file) {
+  auto sequence = std::make_unique<BrightnessSequence>();
+  if (cols_ <= 0 || !sequence->open(file) || sequence->header().cols != cols_ ||
+      sequence->header().rows != rows_) {
+    return false;
+  }
+  stop_sequence();
+  // The first frame is also the still image, e.g. after a restart
+  image_mode_ = true;
+  image_brightness_map_.assign(sequence->front(), sequence->front() + sequence->frame_size());
+  {
+    std::lock_guard<std::mutex> lk(engine_mutex_);
+    sequence_ = std::move(sequence);
+    sequence_frame_time_ = engine_ ? engine_->last_update_time() : 0;
+    if (engine_)
+      engine_->set_image_brightness(image_brightness_map_);
+  }
+  using namespace std::placeholders;
+  sequence_task_ = std::make_unique<espp::Task>(espp::Task::Config{
+      .callback = std::bind(&MatrixRain::read_sequence, this, _1, _2),
+      .task_config =
+          {
+              .name = "Rain Sequence",
+              .stack_size_bytes = 4096,
+              .priority = 1,
+          },
+  });
+  sequence_task_->start();
+  return true;
+}
 
-  for (int y = 0; y < rows_; ++y) {
-    for (int x = 0; x < cols_; ++x) {
-      // Determine the source region in the image for this cell
-      int src_x_start = x * x_scale;
-      int src_x_end = (x + 1) * x_scale;
-      int src_y_start = y * y_scale;
-      int src_y_end = (y + 1) * y_scale;
-
-      // Average the brightness over the source region
-      uint32_t total_brightness = 0;
-      int pixel_count = 0;
-      for (int sy = src_y_start; sy < src_y_end; ++sy) {
-        for (int sx = src_x_start; sx < src_x_end; ++sx) {
-          total_brightness += get_pixel_brightness(img, sx, sy);
-          pixel_count++;
-        }
-      }
+void MatrixRain::stop_sequence() {
+  // Stop reading before the sequence goes away
+  sequence_task_.reset();
+  std::lock_guard<std::mutex> lk(engine_mutex_);
+  sequence_.reset();
+}
 
-      if (pixel_count > 0) {
-        image_brightness_map_[y * cols_ + x] = total_brightness / pixel_count;
-      }
+bool MatrixRain::read_sequence(std::mutex &m, std::condition_variable &cv) {
+  // Only the file is touched here, advance_sequence() picks the frame up once
+  // it's read
+  sequence_->read_next();
+  // Poll twice per frame, so a frame is always read well before it is due
+  auto interval = std::chrono::milliseconds(std::max(sequence_->header().frame_interval_ms / 2, 1));
+  std::unique_lock<std::mutex> lk(m);
+  cv.wait_for(lk, interval);
+  // Keep running until the task is stopped
+  return false;
+}
+
+void MatrixRain::advance_sequence() {
+  // Called with engine_mutex_ held, right after the engine updated. Only the
+  // reveal plays the sequence, see set_image_sequence().
+  if (!sequence_ || !engine_->is_revealing()) {
+    return;
+  }
+  uint32_t now = engine_->last_update_time();
+  if (now - sequence_frame_time_ < sequence_->header().frame_interval_ms) {
+    return;
+  }
+  // If the next frame isn't read yet, keep showing this one
+  if (!sequence_->advance()) {
+    return;
+  }
+  sequence_frame_time_ = now;
+  engine_->update_image_brightness(sequence_->front());
+}
+
+void MatrixRain::set_min_image_brightness(uint8_t brightness) {
+  min_image_brightness_ = brightness;
+  std::lock_guard<std::mutex> lk(engine_mutex_);
+  if (engine_)
+    engine_->set_min_image_brightness(brightness);
+}
+
+void MatrixRain::set_quality_level(int level, int num_levels) {
+  num_levels = std::max(num_levels, 1);
+  level = std::clamp(level, 0, num_levels - 1);
+  std::lock_guard<std::mutex> lk(engine_mutex_);
+  quality_ = RainEngine::Quality{};
+  if (level < num_levels - 1) {
+    quality_.spawn_percent = 100 * (level + 1) / num_levels;
+    if (engine_) {
+      // A share of the drop budget, or of the drops the rain is expected to
+      // have if there's no budget. The pool is sized for the peaks, so a
+      // share of it would hardly cap anything.
+      int max_drops = engine_->drop_budget() > 0 ? engine_->drop_budget()
+                                                 : (int)std::lround(engine_->expected_drops());
+      quality_.max_active_drops = std::max(max_drops * (level + 1) / num_levels, 1);
     }
+    quality_.fade_levels = std::max(config_.fade_levels * (level + 1) / num_levels, 2);
   }
+  if (engine_)
+    engine_->set_quality(quality_);
+}
+
+MatrixRain::Stats MatrixRain::get_stats() const {
+  Stats stats;
+  static_cast<RainEngine::Stats &>(stats) = frame_stats_;
+  stats.rows_skipped = rows_skipped_;
+  return stats;
+}
+
+uint64_t MatrixRain::get_frame_hash() const {
+  std::lock_guard<std::mutex> lk(engine_mutex_);
+  return engine_ ? engine_->frame_hash() : 0;
 }
 
 void MatrixRain::print_image_brightness_map() {
@@ -167,44 +354,120 @@ void MatrixRain::init(lv_obj_t *parent) {
     font_line_height = config_.char_height; // Fallback
   }
   rows_ = std::ceil(config_.screen_height / (float)font_line_height);
+  line_height_ = font_line_height;
+  cell_keys_.assign(cols_ * rows_, 0);
 
-  // Init labels
+  // Init labels. Each label shows a static slice of row_text_ which is rebuilt
+  // in place, so updating the text never allocates.
   row_labels_.clear();
   row_labels_.reserve(rows_);
-  std::string initial_row_text(cols_, ' ');
-  for (int y = 0; y < rows_; ++y) {
-    auto label = lv_label_create(parent_);
-    if (!label)
-      continue;
-    lv_obj_set_size(label, config_.screen_width, font_line_height);
-    lv_obj_set_pos(label, 0, y * font_line_height);
-    lv_label_set_long_mode(label, LV_LABEL_LONG_CLIP);
-    lv_label_set_recolor(label, true);
-    if (font_)
-      lv_obj_set_style_text_font(label, font_, 0);
-    lv_obj_set_style_text_align(label, LV_TEXT_ALIGN_LEFT, 0);
-    lv_obj_set_style_bg_opa(label, LV_OPA_TRANSP, 0);
-    lv_obj_set_style_border_width(label, 0, 0);
-    lv_obj_set_style_pad_all(label, 0, 0);
-    lv_label_set_text(label, initial_row_text.c_str());
-    row_labels_.push_back(label);
-  }
-
-  // Init columns
-  columns_.clear();
-  columns_.reserve(cols_);
-  for (int x = 0; x < cols_; ++x) {
-    Column col;
-    col.cells.resize(rows_);
+  const bool use_labels = !use_framebuffer_renderer && !use_cell_grid_renderer;
+  row_text_stride_ = cols_ * max_cell_text_size + 1;
+  if (use_labels) {
+    row_text_.assign(rows_ * row_text_stride_, '\0');
     for (int y = 0; y < rows_; ++y) {
-      col.cells[y] = CharCell{};
+      auto label = lv_label_create(parent_);
+      if (!label)
+        continue;
+      lv_obj_set_size(label, config_.screen_width, font_line_height);
+      lv_obj_set_pos(label, 0, y * font_line_height);
+      lv_label_set_long_mode(label, LV_LABEL_LONG_CLIP);
+      lv_label_set_recolor(label, true);
+      if (font_)
+        lv_obj_set_style_text_font(label, font_, 0);
+      lv_obj_set_style_text_align(label, LV_TEXT_ALIGN_LEFT, 0);
+      lv_obj_set_style_bg_opa(label, LV_OPA_TRANSP, 0);
+      lv_obj_set_style_border_width(label, 0, 0);
+      lv_obj_set_style_pad_all(label, 0, 0);
+      char *row_text = &row_text_[y * row_text_stride_];
+      memset(row_text, ' ', cols_);
+      lv_label_set_text_static(label, row_text);
+      row_labels_.push_back(label);
     }
-    col.drops.clear();
-    // Randomize last_spawn_time to desynchronize columns
-    col.last_spawn_time = lv_tick_get() + (rand() % config_.drop_spawn_interval_ms);
-    columns_.push_back(std::move(col));
   }
-  last_update_ = lv_tick_get();
+  if (use_framebuffer_renderer) {
+    init_framebuffer();
+  }
+  if (use_cell_grid_renderer) {
+    // One widget for the whole grid, which draws the glyphs in cells of the
+    // same size as the labels' characters
+    cell_grid_ = std::make_unique<CellGrid>(CellGrid::Config{
+        .cols = cols_,
+        .rows = rows_,
+        .cell_width = config_.char_width,
+        .cell_height = font_line_height,
+        .font = font_,
+        .glyph_set = config_.glyph_set,
+    });
+    cell_grid_->init(parent_);
+  }
+  row_dirty_.assign(rows_, 0);
+  if (num_row_workers > 0) {
+    // The GUI task works on the rows too, so start with the other core
+    WorkerPool::Config pool_config;
+    pool_config.num_workers = num_row_workers;
+    for (int i = 0; i < num_row_workers; ++i) {
+      pool_config.core_ids.push_back(i % 2 == 0 ? 1 : 0);
+    }
+    row_workers_ = std::make_unique<WorkerPool>(pool_config);
+  }
+
+  // Start a new simulation on the grid, each with its own seed
+  RainEngine::Config engine_config;
+  static_cast<RainEngine::Params &>(engine_config) = config_;
+  engine_config.seed = seed_rng_.next();
+  engine_config.cols = cols_;
+  engine_config.rows = rows_;
+  engine_config.clock = config_.clock;
+  if (!engine_config.clock)
+    engine_config.clock = [] { return (uint32_t)lv_tick_get(); };
+  engine_ = std::make_unique<RainEngine>(engine_config);
+  engine_->set_min_image_brightness(min_image_brightness_);
+  engine_->set_quality(quality_);
+  if (image_mode_ && image_brightness_map_.size() == (size_t)(cols_ * rows_)) {
+    engine_->set_image_brightness(image_brightness_map_);
+  }
+}
+
+void MatrixRain::start_sim_task() {
+  for (int i = 0; i < 3; ++i) {
+    frames_.buffer(i).keys.assign(cols_ * rows_, 0);
+  }
+  next_sim_time_ = std::chrono::steady_clock::now();
+  using namespace std::placeholders;
+  sim_task_ = std::make_unique<espp::Task>(espp::Task::Config{
+      .callback = std::bind(&MatrixRain::simulate, this, _1, _2),
+      .task_config =
+          {
+              .name = "Rain Sim",
+              .stack_size_bytes = 4096,
+              .priority = 10,
+              .core_id = sim_task_core,
+          },
+  });
+  sim_task_->start();
+}
+
+bool MatrixRain::simulate(std::mutex &m, std::condition_variable &cv) {
+  {
+    std::lock_guard<std::mutex> lk(engine_mutex_);
+    engine_->update();
+    advance_sequence();
+    auto &frame = frames_.back();
+    std::copy_n(engine_->keys(), frame.keys.size(), frame.keys.begin());
+    frame.stats = engine_->stats();
+  }
+  frames_.publish();
+
+  // Keep a steady cadence, but don't try to catch up on frames missed during
+  // a stall: the engine simulates up to the current time anyway.
+  auto now = std::chrono::steady_clock::now();
+  next_sim_time_ = std::max(next_sim_time_ + std::chrono::milliseconds(config_.frame_interval_ms),
+                            now);
+  std::unique_lock<std::mutex> lk(m);
+  cv.wait_until(lk, next_sim_time_);
+  // Keep running until the task is stopped
+  return false;
 }
 
 void MatrixRain::deinit() {
@@ -212,13 +475,21 @@ void MatrixRain::deinit() {
     if (label && lv_obj_is_valid(label))
       lv_obj_del(label);
   }
+  row_workers_.reset();
   row_labels_.clear();
-
-  for (auto &col : columns_) {
-    col.cells.clear();
-    col.drops.clear();
-  }
-  columns_.clear();
+  row_text_.clear();
+  cell_grid_.reset();
+  deinit_framebuffer();
+  row_dirty_.clear();
+
+  // Stop the simulation before the engine it is using goes away
+  sim_task_.reset();
+  {
+    std::lock_guard<std::mutex> lk(engine_mutex_);
+    engine_.reset();
+  }
+  frame_stats_ = {};
+  cell_keys_.clear();
   if (prompt_label_ && lv_obj_is_valid(prompt_label_)) {
     lv_obj_del(prompt_label_);
     prompt_label_ = nullptr;
@@ -232,309 +503,382 @@ void MatrixRain::restart() {
 }
 
 void MatrixRain::update() {
-  uint32_t now = lv_tick_get();
-
-  // State machine for image reveal
-  if (image_mode_) {
-    switch (image_state_) {
-    case ImageRevealState::NORMAL:
-      if (now >= state_transition_time_) {
-        image_state_ = ImageRevealState::CLEARING;
-      }
-      break;
-    case ImageRevealState::CLEARING:
-      if (is_screen_clear()) {
-        image_state_ = ImageRevealState::REVEALING;
-        // Spawn all the image drops at once
-        for (auto &col : columns_) {
-          spawn_drop(col, now, true); // true for image drop
-        }
-        // Set duration for how long the image will be revealed
-        uint32_t duration = config_.image_reveal_min_duration_ms +
-                            (rand() % (config_.image_reveal_max_duration_ms -
-                                       config_.image_reveal_min_duration_ms + 1));
-        state_transition_time_ = now + duration;
-      }
-      break;
-    case ImageRevealState::REVEALING:
-      if (now >= state_transition_time_) {
-        image_state_ = ImageRevealState::ERASING;
-        // Set duration for the erasing animation
-        state_transition_time_ = now + config_.image_erase_duration_ms;
-      }
-      break;
-    case ImageRevealState::ERASING:
-      if (now >= state_transition_time_) {
-        image_state_ = ImageRevealState::NORMAL;
-        set_next_reveal_time();
-      }
-      break;
+  if (!engine_)
+    return;
+  if (use_sim_task && !sim_task_) {
+    // The rain only starts falling once it is first shown
+    start_sim_task();
+  }
+  const uint32_t *keys;
+  if (sim_task_) {
+    // Draw the newest frame the simulation task has finished, if any
+    if (!frames_.acquire()) {
+      rows_skipped_ = rows_;
+      return;
     }
+    keys = frames_.front().keys.data();
+    frame_stats_ = frames_.front().stats;
+  } else {
+    std::lock_guard<std::mutex> lk(engine_mutex_);
+    engine_->update();
+    advance_sequence();
+    keys = engine_->keys();
+    frame_stats_ = engine_->stats();
+  }
+  if (use_framebuffer_renderer) {
+    update_framebuffer(keys);
+  } else if (use_cell_grid_renderer) {
+    update_cell_grid(keys);
+  } else {
+    update_row_labels(keys);
   }
+}
 
-  // Animation update logic
-  for (auto &col : columns_) {
-    // Clear previous drop characters that are not fading. This prepares the
-    // column for the new state of the drops.
-    for (auto &cell : col.cells) {
-      if (!cell.fading) {
-        cell.codepoint = 0;
-      }
-      cell.is_head = false;
+void MatrixRain::update_cell_grid(const uint32_t *keys) {
+  if (!cell_grid_)
+    return;
+  // Comparing the keys of a row doesn't depend on any other row, so the rows
+  // are split across the row workers. Only the invalidation calls LVGL.
+  draw_rows([this, keys](int begin, int end) {
+    for (int y = begin; y < end; ++y) {
+      row_dirty_[y] = cell_grid_->update_row(y, &keys[y * cols_]);
     }
+  });
+  rows_skipped_ = std::count(row_dirty_.begin(), row_dirty_.end(), 0);
+  // Only the cells which changed are redrawn and flushed
+  cell_grid_->invalidate_changed();
+}
 
-    // Possibly spawn a new drop
-    bool should_spawn =
-        (image_state_ == ImageRevealState::NORMAL || image_state_ == ImageRevealState::ERASING);
-    bool is_spawn_time = (now - col.last_spawn_time) > (uint32_t)config_.drop_spawn_interval_ms;
-    if (should_spawn && is_spawn_time) {
-      // randomize drop frequency
-      if (rand() % config_.drop_spawn_chance == 0) {
-        spawn_drop(col, now);
-      }
+void MatrixRain::update_row_labels(const uint32_t *keys) {
+  // Building the text of a row doesn't depend on any other row, so the rows
+  // are split across the row workers. Only the LVGL calls stay in this task.
+  draw_rows([this, keys](int begin, int end) {
+    for (int y = begin; y < end; ++y) {
+      row_dirty_[y] = build_row_text(y, &keys[y * cols_]);
+    }
+  });
+  rows_skipped_ = 0;
+  for (int y = 0; y < rows_; ++y) {
+    if (!row_dirty_[y]) {
+      rows_skipped_++;
+      continue;
     }
+    // The label keeps pointing at its row text, this just makes it re-measure and redraw
+    lv_label_set_text_static(row_labels_[y], &row_text_[y * row_text_stride_]);
+  }
+}
+
+bool MatrixRain::build_row_text(int y, const uint32_t *row_keys) {
+  if (y >= (int)row_labels_.size() || !row_labels_[y])
+    return false;
 
-    // Update all drops in this column
-    for (auto &drop : col.drops) {
-      if (drop.active)
-        update_drop(col, drop, now);
+  // Only rebuild the rows which look different than they did last frame
+  uint32_t *drawn = &cell_keys_[y * cols_];
+  bool dirty = false;
+  for (int x = 0; x < cols_; ++x) {
+    uint32_t key = row_keys[x];
+    dirty |= key != drawn[x];
+    drawn[x] = key;
+  }
+  if (!dirty) {
+    return false;
+  }
+
+  const GlyphSet &glyph_set = *config_.glyph_set;
+  char *out = &row_text_[y * row_text_stride_];
+  for (int x = 0; x < cols_; ++x) {
+    uint32_t key = drawn[x];
+    if (key == 0) {
+      *out++ = ' '; // Use space for empty or fully faded cells
+      continue;
     }
-    // Remove inactive drops
-    col.drops.erase(
-        std::remove_if(col.drops.begin(), col.drops.end(), [](const Drop &d) { return !d.active; }),
-        col.drops.end());
-    // Update fading for all cells
-    update_fade(col, now);
-  }
-  update_row_labels(now);
-  last_update_ = now;
-}
-
-void MatrixRain::spawn_drop(Column &col, uint32_t now, bool is_image_drop) {
-  Drop drop;
-  drop.is_image_drop = is_image_drop;
-  if (is_image_drop) {
-    // Make drops extra long to ensure they cover the screen as they fall
-    drop.length = rows_;
-    drop.speed_ms = config_.image_drop_speed_ms;
-    // Start drops at random negative positions to stagger their appearance
-    drop.head_row = -(rand() % 4);
-  } else {
-    drop.length = config_.min_drop_length +
-                  (rand() % (config_.max_drop_length - config_.min_drop_length + 1));
-    drop.speed_ms = config_.min_speed_ms + (rand() % config_.speed_range_ms);
-    drop.head_row = -1;
-  }
-  drop.last_mutate_time = now;
-  drop.last_advance_time = now;
-  drop.active = true;
-  drop.chars.clear();
-  for (int i = 0; i < drop.length; ++i)
-    drop.chars.push_back(random_katakana());
-  col.drops.push_back(drop);
-  col.last_spawn_time = now;
-}
-
-void MatrixRain::update_drop(Column &col, Drop &drop, uint32_t now) {
-  // Mutate head character rapidly (but not for static image drops)
-  bool is_mutate_time = (now - drop.last_mutate_time) > (uint32_t)config_.head_mutate_interval_ms;
-  if (!drop.is_image_drop && is_mutate_time) {
-    drop.chars.back() = random_katakana();
-    drop.last_mutate_time = now;
-  }
-
-  // Advance head state if it's time
-  bool is_advance_time = (now - drop.last_advance_time) > (uint32_t)drop.speed_ms;
-  if (is_advance_time) {
-    drop.head_row++;
-    drop.last_advance_time = now;
-
-    // Shift tail chars and add a new one
-    drop.chars.pop_front();
-    drop.chars.push_back(random_katakana());
-
-    // If the whole drop is offscreen, mark inactive
-    if (drop.head_row - drop.length >= (int)col.cells.size()) {
-      drop.active = false;
+    const ColorTag *tag;
+    switch (RainEngine::key_kind(key)) {
+    case RainEngine::KEY_HEAD:
+      tag = &head_tag;
+      break;
+    case RainEngine::KEY_BODY:
+      tag = &body_tag;
+      break;
+    default:
+      tag = &fade_tags[RainEngine::key_level(key)];
+      break;
     }
+    memcpy(out, tag->data(), tag->size());
+    out += tag->size();
+    uint8_t glyph = RainEngine::key_glyph(key);
+    memcpy(out, glyph_set.utf8[glyph].data(), glyph_set.utf8_lengths[glyph]);
+    out += glyph_set.utf8_lengths[glyph];
+    *out++ = '#';
+  }
+  *out = '\0';
+  return true;
+}
+
+void MatrixRain::draw_rows(const WorkerPool::chunk_fn &fn) {
+  if (row_workers_) {
+    // A few chunks per task, so a slow row doesn't hold up the whole frame
+    int chunk_size = std::max(rows_ / (4 * (row_workers_->num_workers() + 1)), 1);
+    row_workers_->run(rows_, chunk_size, fn);
+  } else {
+    fn(0, rows_);
   }
+}
 
-  // Always paint the drop's current state into the cell buffer,
-  // as long as it's active.
-  if (drop.active) {
-    for (int i = 0; i < drop.length; ++i) {
-      int row = drop.head_row - i;
-      if (row >= 0 && row < (int)col.cells.size()) {
-        auto &cell = col.cells[row];
-        cell.codepoint = drop.chars[drop.length - 1 - i];
-        cell.is_head = (i == 0);
-
-        if (cell.is_head) {
-          cell.fading = false;
-        } else {
-          cell.fading = true;
-          // Create a fake start time in the past to simulate a spatial gradient.
-          // The further down the tail (higher i), the more faded the char is.
-          uint32_t offset = (config_.fade_duration_ms / (config_.max_drop_length + 2)) * i;
-          cell.fade_start_time = now - offset;
-        }
-      }
-    }
+void MatrixRain::init_framebuffer() {
+  size_t num_bytes = config_.screen_width * config_.screen_height * sizeof(uint16_t);
+  framebuffer_ = (uint16_t *)heap_caps_malloc(num_bytes, MALLOC_CAP_8BIT);
+  if (!framebuffer_) {
+    fmt::print("Couldn't allocate {} bytes for the matrix rain framebuffer!\n", num_bytes);
+    return;
   }
+  memset(framebuffer_, 0, num_bytes);
+  canvas_ = lv_canvas_create(parent_);
+  lv_canvas_set_buffer(canvas_, framebuffer_, config_.screen_width, config_.screen_height,
+                       LV_COLOR_FORMAT_RGB565);
+  lv_obj_set_pos(canvas_, 0, 0);
+  build_glyph_cache();
 }
 
-void MatrixRain::update_fade(Column &col, uint32_t now) {
-  for (auto &cell : col.cells) {
-    if (cell.fading) {
-      float progress = (now - cell.fade_start_time) / (float)config_.fade_duration_ms;
-      if (progress >= 1.0f) {
-        // Fade complete, clear cell
-        cell.fading = false;
-        cell.codepoint = 0;
-      }
+void MatrixRain::deinit_framebuffer() {
+  if (canvas_ && lv_obj_is_valid(canvas_))
+    lv_obj_del(canvas_);
+  canvas_ = nullptr;
+  if (framebuffer_) {
+    heap_caps_free(framebuffer_);
+    framebuffer_ = nullptr;
+  }
+  glyphs_.clear();
+  glyph_atlas_.reset();
+}
+
+void MatrixRain::build_glyph_cache() {
+  const lv_font_t *font = font_ ? font_ : lv_obj_get_style_text_font(parent_, LV_PART_MAIN);
+  const GlyphSet &glyph_set = *config_.glyph_set;
+  glyphs_.assign(glyph_set.size, Glyph{});
+  for (int i = 0; i < glyph_set.size; ++i) {
+    uint32_t codepoint = glyph_set.codepoint(i);
+    if (!find_glyph(font, codepoint, glyphs_[i])) {
+      fmt::print("Glyph U+{:04X} not found, it will be drawn as a space\n", codepoint);
     }
   }
+  if (!use_glyph_atlas)
+    return;
+  // Pre-rasterize every glyph in every color, so drawing a cell is a copy
+  glyph_atlas_ = std::make_unique<GlyphAtlas>(GlyphAtlas::Config{
+      .cell_width = config_.char_width,
+      .cell_height = line_height_,
+      .num_levels = config_.fade_levels,
+      .glyph_set = config_.glyph_set,
+  });
+  if (!glyph_atlas_->build(glyphs_.data())) {
+    fmt::print("Couldn't allocate the glyph atlas, the glyphs will be blitted instead\n");
+    glyph_atlas_.reset();
+    return;
+  }
+  fmt::print("Glyph atlas: {} bytes in {}\n", glyph_atlas_->size_bytes(),
+             glyph_atlas_->in_psram() ? "PSRAM" : "internal RAM");
 }
 
-void MatrixRain::update_row_labels(uint32_t now) {
-  char utf8[5] = {0};
+void MatrixRain::update_framebuffer(const uint32_t *keys) {
+  if (!framebuffer_)
+    return;
+  // Every row covers its own part of the framebuffer, so the rows can be
+  // rasterized by the row workers at the same time
+  draw_rows([this, keys](int begin, int end) {
+    for (int y = begin; y < end; ++y) {
+      row_dirty_[y] = draw_framebuffer_row(y, &keys[y * cols_]);
+    }
+  });
+  rows_skipped_ = 0;
+  lv_area_t canvas_area;
+  lv_obj_get_coords(canvas_, &canvas_area);
   for (int y = 0; y < rows_; ++y) {
-    if (y >= row_labels_.size() || !row_labels_[y])
+    if (!row_dirty_[y]) {
+      rows_skipped_++;
       continue;
-
-    std::string text_buffer;
-    text_buffer.reserve(cols_ * (10 + 5)); // Approx: #RRGGBB + utf8 + # + space
-
-    for (int x = 0; x < cols_; ++x) {
-      const auto &cell = columns_[x].cells[y];
-      if (cell.codepoint == 0) {
-        text_buffer += " ";
-        continue;
-      }
-
-      unicode_to_utf8(cell.codepoint, utf8);
-
-      if (cell.is_head) {
-        if (image_mode_ && image_state_ == ImageRevealState::REVEALING) {
-          uint8_t brightness = image_brightness_map_[y * cols_ + x];
-          if (brightness < min_image_brightness_) {
-            text_buffer += " "; // Use space for very dark pixels
-            continue;
-          }
-        }
-        text_buffer += fmt::format("#B6FF00 {}#", utf8);
-      } else if (cell.fading) {
-        float fade_duration = config_.fade_duration_ms;
-        if (image_mode_ && image_state_ == ImageRevealState::REVEALING) {
-          uint8_t brightness = image_brightness_map_[y * cols_ + x];
-          // For dark pixels, make the character disappear almost instantly.
-          if (brightness < min_image_brightness_) {
-            text_buffer += " ";
-            continue;
-          }
-          // For brighter pixels, make the fade duration longer.
-          fade_duration = 1.0f + (config_.fade_duration_ms * (brightness / 255.0f)) * 5.0f;
-        }
-
-        float progress = (now - cell.fade_start_time) / fade_duration;
-        progress = std::min(progress, 1.0f);
-
-        // Once faded, render a space to be transparent.
-        if (progress >= 1.0f) {
-          text_buffer += " ";
-        } else {
-          uint8_t green = 0xFF * (1.0f - progress);
-          text_buffer += fmt::format("#00{:02X}00 {}#", green, utf8);
-        }
-      } else {
-        // This case is for the body of the drop, which is not the head and not fading yet.
-        text_buffer += fmt::format("#00FF00 {}#", utf8);
-      }
     }
-    lv_label_set_text(row_labels_[y], text_buffer.c_str());
+    // Only the rows which changed need to be redrawn and flushed
+    lv_area_t row_area = canvas_area;
+    row_area.y1 = canvas_area.y1 + y * line_height_;
+    row_area.y2 = row_area.y1 + line_height_ - 1;
+    lv_obj_invalidate_area(canvas_, &row_area);
   }
 }
 
-uint32_t MatrixRain::random_katakana() { return 0x30A0 + (rand() % (0x30FF - 0x30A0 + 1)); }
-
-void MatrixRain::unicode_to_utf8(uint32_t unicode, char *utf8) {
-  if (unicode < 0x80)
-    utf8[0] = unicode;
-  else if (unicode < 0x800) {
-    utf8[0] = 0xC0 | (unicode >> 6);
-    utf8[1] = 0x80 | (unicode & 0x3F);
-  } else if (unicode < 0x10000) {
-    utf8[0] = 0xE0 | (unicode >> 12);
-    utf8[1] = 0x80 | ((unicode >> 6) & 0x3F);
-    utf8[2] = 0x80 | (unicode & 0x3F);
-  } else {
-    utf8[0] = 0xF0 | (unicode >> 18);
-    utf8[1] = 0x80 | ((unicode >> 12) & 0x3F);
-    utf8[2] = 0x80 | ((unicode >> 6) & 0x3F);
-    utf8[3] = 0x80 | (unicode & 0x3F);
+bool MatrixRain::draw_framebuffer_row(int y, const uint32_t *row_keys) {
+  uint32_t *drawn = &cell_keys_[y * cols_];
+  bool dirty = false;
+  for (int x = 0; x < cols_; ++x) {
+    uint32_t key = row_keys[x];
+    if (key == drawn[x])
+      continue;
+    drawn[x] = key;
+    dirty = true;
+    if (glyph_atlas_) {
+      copy_tile(x, y, glyph_atlas_->tile(key));
+      continue;
+    }
+    const Glyph *glyph = key ? &glyphs_[RainEngine::key_glyph(key)] : nullptr;
+    draw_cell(x, y, glyph, lv_color_to_u16(lv_color_hex(RainEngine::key_color(key))));
   }
+  return dirty;
 }
 
-uint8_t MatrixRain::get_pixel_brightness(const lv_img_dsc_t *img, int x, int y) {
-  if (x < 0 || x >= img->header.w || y < 0 || y >= img->header.h) {
-    return 0;
+void MatrixRain::draw_cell(int x, int y, const Glyph *glyph, uint16_t color) {
+  const int stride = config_.screen_width;
+  const int cell_x = x * config_.char_width;
+  const int cell_y = y * line_height_;
+  // The last row / column may be clipped by the edge of the screen
+  const int cell_w = std::min(config_.char_width, config_.screen_width - cell_x);
+  const int cell_h = std::min(line_height_, config_.screen_height - cell_y);
+  if (cell_w <= 0 || cell_h <= 0)
+    return;
+
+  uint16_t *origin = framebuffer_ + cell_y * stride + cell_x;
+  for (int py = 0; py < cell_h; ++py) {
+    std::fill_n(origin + py * stride, cell_w, 0);
   }
+  if (!glyph || !glyph->bitmap)
+    return;
 
-  // This function currently supports ARGB8888 and RGB565 (NATIVE).
-  // To support more formats, add cases here.
-  switch (img->header.cf) {
-  case LV_COLOR_FORMAT_RGB565: {
-    const uint16_t *data_u16 = (const uint16_t *)img->data;
-    uint16_t pixel = data_u16[y * img->header.w + x];
-
-    // Extract R, G, B components from RGB565
-    uint8_t r5 = (pixel >> 11) & 0x1F;
-    uint8_t g6 = (pixel >> 5) & 0x3F;
-    uint8_t b5 = pixel & 0x1F;
-
-    // Scale to 8-bit
-    uint8_t r8 = (r5 << 3) | (r5 >> 2);
-    uint8_t g8 = (g6 << 2) | (g6 >> 4);
-    uint8_t b8 = (b5 << 3) | (b5 >> 2);
-
-    // Calculate brightness (luma)
-    return (r8 * 77 + g8 * 151 + b8 * 28) >> 8;
-  }
-  case LV_COLOR_FORMAT_ARGB8888: {
-    const uint8_t *data_u8 = (const uint8_t *)img->data;
-    // For little-endian systems (like ESP32), ARGB8888 is stored as BGRA in memory.
-    uint32_t px_offset = (y * img->header.w + x) * 4;
-    uint8_t b = data_u8[px_offset + 0];
-    uint8_t g = data_u8[px_offset + 1];
-    uint8_t r = data_u8[px_offset + 2];
-    uint8_t a = data_u8[px_offset + 3];
-
-    if (a == 0) {
-      return 0;
+  // Bits are packed MSB first and rows are not padded to a byte boundary
+  uint32_t bit = 0;
+  for (int gy = 0; gy < glyph->height; ++gy) {
+    int py = glyph->y + gy;
+    for (int gx = 0; gx < glyph->width; ++gx, ++bit) {
+      int px = glyph->x + gx;
+      if (px < 0 || px >= cell_w || py < 0 || py >= cell_h)
+        continue;
+      if (glyph->bitmap[bit >> 3] & (0x80 >> (bit & 0x7)))
+        origin[py * stride + px] = color;
     }
+  }
+}
+
+void MatrixRain::copy_tile(int x, int y, const uint16_t *tile) {
+  const int stride = config_.screen_width;
+  const int cell_x = x * config_.char_width;
+  const int cell_y = y * line_height_;
+  // The last row / column may be clipped by the edge of the screen
+  const int cell_w = std::min(config_.char_width, config_.screen_width - cell_x);
+  const int cell_h = std::min(line_height_, config_.screen_height - cell_y);
+  if (cell_w <= 0 || cell_h <= 0)
+    return;
 
-    // Standard RGB to luma conversion, weighted by alpha.
-    uint32_t brightness = (r * 77 + g * 151 + b * 28) >> 8;
-    return (brightness * a) / 255;
+  uint16_t *origin = framebuffer_ + cell_y * stride + cell_x;
+  for (int py = 0; py < cell_h; ++py) {
+    if (tile)
+      memcpy(origin + py * stride, tile + py * config_.char_width, cell_w * sizeof(uint16_t));
+    else
+      std::fill_n(origin + py * stride, cell_w, 0);
   }
+}
+
+bool MatrixRain::get_brightness_image(const lv_img_dsc_t *img, BrightnessMap::Image &image) {
+  using Format = BrightnessMap::Format;
+  int palette_size = 0;
+  switch (img->header.cf) {
+  case LV_COLOR_FORMAT_RGB565:
+    image.format = Format::RGB565;
+    break;
+  case LV_COLOR_FORMAT_RGB565_SWAPPED:
+    image.format = Format::RGB565_SWAPPED;
+    break;
+  case LV_COLOR_FORMAT_RGB888:
+    image.format = Format::RGB888;
+    break;
+  case LV_COLOR_FORMAT_ARGB8888:
+    image.format = Format::ARGB8888;
+    break;
+  case LV_COLOR_FORMAT_XRGB8888:
+    image.format = Format::XRGB8888;
+    break;
+  case LV_COLOR_FORMAT_L8:
+    image.format = Format::L8;
+    break;
+  case LV_COLOR_FORMAT_I1:
+    image.format = Format::I1;
+    palette_size = 2;
+    break;
+  case LV_COLOR_FORMAT_I2:
+    image.format = Format::I2;
+    palette_size = 4;
+    break;
+  case LV_COLOR_FORMAT_I4:
+    image.format = Format::I4;
+    palette_size = 16;
+    break;
+  case LV_COLOR_FORMAT_I8:
+    image.format = Format::I8;
+    palette_size = 256;
+    break;
   default:
-    // Unsupported format, return 0 (black).
-    return 0;
-  }
+    // To support more formats, add a kernel to BrightnessMap
+    return false;
+  }
+  image.width = img->header.w;
+  image.height = img->header.h;
+  image.stride = img->header.stride;
+  // Indexed images start with their palette (lv_color32_t entries)
+  image.palette = palette_size ? img->data : nullptr;
+  image.pixels = img->data + palette_size * sizeof(lv_color32_t);
+  return image.width > 0 && image.height > 0 && img->data;
 }
 
-bool MatrixRain::is_screen_clear() {
-  for (const auto &col : columns_) {
-    if (!col.drops.empty()) {
-      return false;
+bool MatrixRain::find_glyph(const lv_font_t *font, uint32_t codepoint, Glyph &glyph) {
+  if (!font)
+    return false;
+  // Glyph offsets are relative to the line of the primary font, even when the
+  // glyph itself comes from a fallback font (this matches lv_draw_label).
+  const int baseline_y = font->line_height - font->base_line;
+  for (auto f = font; f; f = f->fallback) {
+    // Only uncompressed 1bpp fonts in the lv_font_fmt_txt format can be blitted
+    if (f->get_glyph_bitmap != lv_font_get_bitmap_fmt_txt)
+      continue;
+    auto dsc = static_cast<const lv_font_fmt_txt_dsc_t *>(f->dsc);
+    if (!dsc || dsc->bpp != 1 || dsc->bitmap_format != 0)
+      continue;
+    for (uint16_t i = 0; i < dsc->cmap_num; ++i) {
+      const auto &cmap = dsc->cmaps[i];
+      uint32_t rcp = codepoint - cmap.range_start;
+      if (codepoint < cmap.range_start || rcp >= cmap.range_length)
+        continue;
+      uint32_t glyph_id = 0;
+      switch (cmap.type) {
+      case LV_FONT_FMT_TXT_CMAP_FORMAT0_TINY:
+        glyph_id = cmap.glyph_id_start + rcp;
+        break;
+      case LV_FONT_FMT_TXT_CMAP_FORMAT0_FULL:
+        glyph_id = cmap.glyph_id_start + ((const uint8_t *)cmap.glyph_id_ofs_list)[rcp];
+        break;
+      case LV_FONT_FMT_TXT_CMAP_SPARSE_TINY:
+      case LV_FONT_FMT_TXT_CMAP_SPARSE_FULL: {
+        auto list_end = cmap.unicode_list + cmap.list_length;
+        auto it = std::lower_bound(cmap.unicode_list, list_end, rcp);
+        if (it == list_end || *it != rcp)
+          continue;
+        size_t index = it - cmap.unicode_list;
+        glyph_id = cmap.glyph_id_start;
+        if (cmap.type == LV_FONT_FMT_TXT_CMAP_SPARSE_FULL)
+          glyph_id += ((const uint16_t *)cmap.glyph_id_ofs_list)[index];
+        else
+          glyph_id += index;
+        break;
+      }
+      default:
+        continue;
+      }
+      if (glyph_id == 0)
+        continue;
+      const auto &glyph_dsc = dsc->glyph_dsc[glyph_id];
+      glyph.bitmap = &dsc->glyph_bitmap[glyph_dsc.bitmap_index];
+      glyph.width = glyph_dsc.box_w;
+      glyph.height = glyph_dsc.box_h;
+      glyph.x = glyph_dsc.ofs_x;
+      glyph.y = baseline_y - glyph_dsc.box_h - glyph_dsc.ofs_y;
+      return true;
     }
   }
-  return true;
-}
-
-void MatrixRain::set_next_reveal_time() {
-  uint32_t interval =
-      config_.image_reveal_min_interval_ms +
-      (rand() % (config_.image_reveal_max_interval_ms - config_.image_reveal_min_interval_ms + 1));
-  state_transition_time_ = lv_tick_get() + interval;
+  return false;
 }
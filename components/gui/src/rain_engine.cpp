@@ -0,0 +1,768 @@
+#include "rain_engine.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+RainEngine::Params RainEngine::scaled_params(int num_rows) {
+  Params params;
+  num_rows = std::max(num_rows, 1);
+  params.drop_spawn_chance = std::max<int>(300 / num_rows, 20); // larger number = less chance
+  params.min_drop_length = std::max(num_rows / 8, 1);
+  params.max_drop_length = std::max(num_rows / 3, params.min_drop_length);
+  params.min_speed_ms = std::max<int>(750 / num_rows, 50);
+  params.speed_range_ms = std::max<int>(2000 / num_rows, 100) - params.min_speed_ms;
+  params.image_drop_speed_ms = std::max<int>(500 / num_rows, 25);
+  return params;
+}
+
+std::vector<RainEngine::Layer> RainEngine::depth_layers(const Params &params, int num_layers) {
+  std::vector<Layer> layers;
+  for (int i = 1; i <= num_layers; ++i) {
+    Layer layer;
+    // Farther drops seem to fall more slowly, and are dimmer
+    layer.min_speed_ms = params.min_speed_ms * (i + 1);
+    layer.speed_range_ms = params.speed_range_ms * (i + 1);
+    layer.intensity_percent = std::max(50 >> (i - 1), 10);
+    layers.push_back(layer);
+  }
+  return layers;
+}
+
+RainEngine::RainEngine(const Config &config)
+    : config_(config)
+    , clock_(config.clock)
+    , glyph_set_(config.glyph_set && config.glyph_set->size > 0 ? config.glyph_set
+                                                                : &katakana_glyph_set)
+    , cols_(std::max(config.cols, 1))
+    , rows_(std::max(config.rows, 1))
+    , rng_(config.seed) {
+  restart();
+  set_next_reveal_time(clock_());
+  init_layers();
+}
+
+void RainEngine::init_layers() {
+  layers_.clear();
+  for (size_t i = 0; i < config_.layers.size(); ++i) {
+    const Layer &layer = config_.layers[i];
+    Config config = config_;
+    config.layers.clear();
+    config.drop_budget = 0;
+    config.max_drops = 0;
+    config.cols = cols_;
+    config.rows = rows_;
+    config.min_speed_ms = std::max(layer.min_speed_ms, 1);
+    config.speed_range_ms = std::max(layer.speed_range_ms, 0);
+    // Spawning less often is the same as waiting longer between spawns
+    int density = std::max(layer.density_percent, 1);
+    config.drop_spawn_interval_ms = config_.drop_spawn_interval_ms * 100 / density;
+    config.drop_spawn_chance = std::max(config_.drop_spawn_chance * 100 / density, 1);
+    // A seed of its own, without drawing from this rain's generator
+    config.seed = config_.seed + (i + 1) * 0x9E3779B9u;
+    auto engine = std::make_unique<RainEngine>(config);
+    int intensity = std::clamp(layer.intensity_percent, 0, 100);
+    for (int green = 0; green < 256; ++green) {
+      engine->dim_levels_[green] = std::max(green * intensity / 100, 1);
+    }
+    engine->track_key_changes();
+    layers_.push_back(std::move(engine));
+  }
+  drop_budget_ = config_.drop_budget;
+  if (!layers_.empty()) {
+    track_key_changes();
+    frame_keys_.assign(keys_.size(), 0);
+    // By default the layers share half the drops the rain would have on its
+    // own. Drops which are spread out over the layers overlap less, so each
+    // keeps more cells fading, and the layers are composited on top of that:
+    // half the drops take about as long to simulate as the rain alone.
+    if (drop_budget_ <= 0)
+      drop_budget_ = std::max<int>(std::lround(expected_drops() / 2), 1);
+  }
+  drop_budget_ = std::max(drop_budget_, 0);
+  apply_drop_budget();
+  // A layer has no image drops, so it never has more drops than its share
+  // of the budget, and its pool only needs to hold that many. The front rain
+  // also needs room for the image drops, one per column on a clear screen.
+  for (auto &layer : layers_) {
+    if (layer->drop_cap_ < (int)layer->drops_.size()) {
+      layer->config_.max_drops = std::max(layer->drop_cap_, 1);
+      layer->restart();
+    }
+  }
+  if (drop_budget_ > 0 && std::max(drop_cap_, cols_) < (int)drops_.size()) {
+    config_.max_drops = std::max(drop_cap_, cols_);
+    restart();
+  }
+}
+
+void RainEngine::track_key_changes() {
+  track_changes_ = true;
+  all_keys_changed_ = true;
+  key_changed_.assign(keys_.size(), 0);
+  changed_keys_.clear();
+  changed_keys_.reserve(keys_.size());
+}
+
+void RainEngine::restart() {
+  uint32_t now = clock_();
+  cells_.assign(cols_ * rows_, Cell{});
+  keys_.assign(cols_ * rows_, 0);
+  columns_.assign(cols_, Column{});
+  dirty_columns_.clear();
+  dirty_columns_.reserve(cols_);
+  // A cell is queued at most once, so this never grows during an update
+  fading_.clear();
+  fading_.reserve(cols_ * rows_);
+  init_fade();
+  keys_dirty_ = false;
+  init_drop_pool();
+  active_image_drops_ = 0;
+  fading_cells_ = 0;
+  if (track_changes_)
+    track_key_changes();
+  if (!layers_.empty())
+    frame_keys_.assign(keys_.size(), 0);
+  for (auto &layer : layers_)
+    layer->restart();
+  timers_.init(drops_.size() * 2 + cols_, now);
+  spawn_log_q_ =
+      config_.drop_spawn_chance > 1 ? std::log1p(-1.0f / config_.drop_spawn_chance) : 0.0f;
+  for (int x = 0; x < cols_; ++x) {
+    // Randomize the first spawn to desynchronize columns
+    schedule_spawn(x, now + rng_.uniform(config_.drop_spawn_interval_ms), true);
+  }
+  last_update_ = now;
+}
+
+void RainEngine::set_image_brightness(std::vector<uint8_t> brightness_map) {
+  if (brightness_map.size() != cells_.size()) {
+    image_mode_ = false;
+    image_brightness_map_.clear();
+    image_fade_rates_.clear();
+    return;
+  }
+  image_mode_ = true;
+  keys_dirty_ = true;
+  image_brightness_map_ = std::move(brightness_map);
+  image_fade_rates_.resize(cells_.size());
+  for (size_t i = 0; i < image_brightness_map_.size(); ++i) {
+    image_fade_rates_[i] = make_image_fade_rate(image_brightness_map_[i]);
+  }
+  // The image drops shade their cells by the new image
+  for (int x = 0; x < cols_; ++x) {
+    mark_dirty(x);
+  }
+}
+
+void RainEngine::update_image_brightness(const uint8_t *brightness_map) {
+  if (!image_mode_) {
+    return;
+  }
+  for (size_t i = 0; i < image_brightness_map_.size(); ++i) {
+    if (brightness_map[i] != image_brightness_map_[i]) {
+      image_brightness_map_[i] = brightness_map[i];
+      image_fade_rates_[i] = make_image_fade_rate(brightness_map[i]);
+      // A cell under a drop is shaded by the new brightness when its column
+      // is painted, the fading cells pick it up in update_fade()
+      if (cells_[i].flags & (Cell::HEAD | Cell::PINNED)) {
+        mark_dirty(i % cols_);
+      }
+    }
+  }
+}
+
+RainEngine::FadeRate RainEngine::make_image_fade_rate(uint8_t brightness) const {
+  // Brighter pixels fade more slowly, so they stay visible for longer
+  return make_fade_rate(1 + config_.fade_duration_ms * 5 * brightness / 255);
+}
+
+void RainEngine::set_quality(const Quality &quality) {
+  bool fade_changed = quality.fade_levels != quality_.fade_levels;
+  quality_ = quality;
+  if (fade_changed) {
+    init_fade();
+    keys_dirty_ = true;
+  }
+  for (auto &layer : layers_) {
+    layer->set_quality({
+        .spawn_percent = quality.spawn_percent,
+        .fade_levels = quality.fade_levels,
+    });
+  }
+  apply_drop_budget();
+}
+
+void RainEngine::apply_drop_budget() {
+  int budget = drop_budget_;
+  if (quality_.max_active_drops > 0)
+    budget = budget > 0 ? std::min(budget, quality_.max_active_drops) : quality_.max_active_drops;
+  if (budget <= 0) {
+    drop_cap_ = INT_MAX;
+    return;
+  }
+  // Share the budget out by the drops each layer is expected to have, so a
+  // tight budget thins every layer out evenly instead of starving the far
+  // ones. The shares are rounded down and the front rain gets what's left,
+  // so they never add up to more than the budget.
+  float total = expected_drops();
+  for (auto &layer : layers_)
+    total += layer->expected_drops();
+  drop_cap_ = budget;
+  for (auto &layer : layers_) {
+    layer->drop_cap_ = budget * layer->expected_drops() / total;
+    drop_cap_ -= layer->drop_cap_;
+  }
+}
+
+float RainEngine::expected_drops() const {
+  // A column spawns a drop once the spawn interval has passed and the spawn
+  // chance came up, which takes drop_spawn_chance - 1 frames on average
+  float spawn_ms = config_.drop_spawn_interval_ms + 1 +
+                   std::max(config_.drop_spawn_chance - 1, 0) * (float)config_.frame_interval_ms;
+  if (quality_.spawn_percent < 100)
+    spawn_ms = spawn_ms * 100 / std::max(quality_.spawn_percent, 1);
+  // and the drop falls until its tail leaves the screen
+  float length = (config_.min_drop_length + config_.max_drop_length) / 2.0f;
+  float speed_ms = config_.min_speed_ms + config_.speed_range_ms / 2.0f + 1;
+  float lifetime_ms = (rows_ + length + 1) * speed_ms;
+  return cols_ * lifetime_ms / spawn_ms;
+}
+
+int RainEngine::active_drops() const {
+  int drops = pool_drops();
+  for (const auto &layer : layers_)
+    drops += layer->pool_drops();
+  return drops;
+}
+
+int RainEngine::max_drops() const {
+  int drops = drops_.size();
+  for (const auto &layer : layers_)
+    drops += layer->drops_.size();
+  return drops;
+}
+
+size_t RainEngine::memory_bytes() const {
+  size_t bytes = sizeof(*this) + timers_.memory_bytes();
+  bytes += cells_.capacity() * sizeof(Cell);
+  bytes += (keys_.capacity() + frame_keys_.capacity()) * sizeof(uint32_t);
+  bytes += key_changed_.capacity() + changed_keys_.capacity() * sizeof(int);
+  bytes += columns_.capacity() * sizeof(Column);
+  bytes += drops_.capacity() * sizeof(Drop) + drop_glyphs_.capacity();
+  bytes += dirty_columns_.capacity() * sizeof(int);
+  bytes += (free_drops_.capacity() + fading_.capacity()) * sizeof(int);
+  bytes += image_brightness_map_.capacity() + image_fade_rates_.capacity() * sizeof(FadeRate);
+  bytes += fade_lut_.capacity();
+  bytes += layers_.capacity() * sizeof(layers_[0]);
+  for (const auto &layer : layers_)
+    bytes += layer->memory_bytes();
+  return bytes;
+}
+
+RainEngine::Stats RainEngine::stats() const {
+  Stats stats{
+      .active_drops = pool_drops(),
+      .active_image_drops = active_image_drops_,
+      .fading_cells = fading_cells_,
+  };
+  for (const auto &layer : layers_) {
+    stats.active_drops += layer->pool_drops();
+    stats.active_layer_drops += layer->pool_drops();
+    stats.fading_cells += layer->fading_cells_;
+  }
+  return stats;
+}
+
+void RainEngine::update() { update_at(clock_()); }
+
+void RainEngine::update_at(uint32_t now) {
+  const uint32_t last_paint = last_update_;
+  last_update_ = now;
+
+  // State machine for image reveal
+  if (image_mode_) {
+    update_image_state(now);
+  }
+
+  // Only the drops and columns which are due do any work here, and only the
+  // columns whose drops moved are painted again
+  timers_.advance(now, [this, now](int id) { on_timer(id, now); });
+  paint_dirty_columns(last_paint);
+
+  // Only the fading cells change with time
+  update_fade(now);
+  if (keys_dirty_) {
+    update_keys(now);
+    keys_dirty_ = false;
+  }
+
+  if (!layers_.empty()) {
+    for (auto &layer : layers_) {
+      // The layers stop spawning with the front rain, so the whole screen
+      // clears before the image is revealed
+      layer->hold_spawns(!can_spawn(), now);
+      layer->update_at(now);
+    }
+    composite();
+  }
+}
+
+void RainEngine::hold_spawns(bool hold, uint32_t now) {
+  if (hold == spawn_held_)
+    return;
+  spawn_held_ = hold;
+  if (!hold)
+    resume_parked_spawns(now);
+}
+
+void RainEngine::resume_parked_spawns(uint32_t now) {
+  // Restart spawning in the columns which were paused. Their spawn interval
+  // has long passed, so they only wait for the spawn chance.
+  for (int x = 0; x < cols_; ++x) {
+    if (columns_[x].spawn_parked) {
+      columns_[x].spawn_parked = false;
+      schedule_spawn(x, now, false);
+    }
+  }
+}
+
+void RainEngine::composite() {
+  bool all_changed = all_keys_changed_;
+  for (const auto &layer : layers_)
+    all_changed |= layer->all_keys_changed_;
+  if (all_changed) {
+    for (int i = 0; i < (int)keys_.size(); ++i)
+      frame_keys_[i] = composite_key(i);
+  } else {
+    // Only the cells whose key changed in some layer
+    for (int i : changed_keys_)
+      frame_keys_[i] = composite_key(i);
+    for (const auto &layer : layers_) {
+      for (int i : layer->changed_keys_)
+        frame_keys_[i] = composite_key(i);
+    }
+  }
+  clear_changes();
+  for (auto &layer : layers_)
+    layer->clear_changes();
+}
+
+uint32_t RainEngine::composite_key(int index) const {
+  // The nearest glyph covers the ones behind it
+  if (keys_[index])
+    return keys_[index];
+  for (const auto &layer : layers_) {
+    if (uint32_t key = layer->keys_[index])
+      return layer->dim_key(key);
+  }
+  return 0;
+}
+
+void RainEngine::clear_changes() {
+  for (int i : changed_keys_)
+    key_changed_[i] = 0;
+  changed_keys_.clear();
+  all_keys_changed_ = false;
+}
+
+void RainEngine::set_image_state(ImageRevealState state) {
+  // Cells fade (and dark cells hide) differently while the image is shown
+  bool was_revealing = is_revealing();
+  image_state_ = state;
+  if (is_revealing() != was_revealing) {
+    keys_dirty_ = true;
+  }
+}
+
+void RainEngine::update_image_state(uint32_t now) {
+  switch (image_state_) {
+  case ImageRevealState::NORMAL:
+    if (now >= state_transition_time_) {
+      set_image_state(ImageRevealState::CLEARING);
+    }
+    break;
+  case ImageRevealState::CLEARING:
+    if (is_screen_clear()) {
+      set_image_state(ImageRevealState::REVEALING);
+      // Spawn all the image drops at once
+      for (int x = 0; x < cols_; ++x) {
+        spawn_drop(x, now, true); // true for image drop
+      }
+      // Set duration for how long the image will be revealed
+      uint32_t duration =
+          rng_.range(config_.image_reveal_min_duration_ms, config_.image_reveal_max_duration_ms);
+      state_transition_time_ = now + duration;
+    }
+    break;
+  case ImageRevealState::REVEALING:
+    if (now >= state_transition_time_) {
+      set_image_state(ImageRevealState::ERASING);
+      // Set duration for the erasing animation
+      state_transition_time_ = now + config_.image_erase_duration_ms;
+      // Spawning was paused while the screen cleared and the image was shown
+      resume_parked_spawns(now);
+    }
+    break;
+  case ImageRevealState::ERASING:
+    if (now >= state_transition_time_) {
+      set_image_state(ImageRevealState::NORMAL);
+      set_next_reveal_time(now);
+    }
+    break;
+  }
+}
+
+void RainEngine::init_drop_pool() {
+  int capacity = config_.max_drops;
+  if (capacity <= 0) {
+    // A column can spawn at most one drop per spawn interval, and a drop lives
+    // for as long as it takes its tail to leave the screen at the slowest
+    // speed. Leave room for an image drop and a partially elapsed interval.
+    int max_speed_ms = config_.min_speed_ms + config_.speed_range_ms;
+    int max_lifetime_ms = (rows_ + config_.max_drop_length + 1) * (max_speed_ms + 1);
+    int drops_per_column = max_lifetime_ms / (config_.drop_spawn_interval_ms + 1) + 2;
+    capacity = cols_ * drops_per_column;
+  }
+  // Image drops are as long as the screen is tall
+  int max_length = std::max(config_.max_drop_length, rows_);
+  drops_.assign(capacity, Drop{});
+  drops_.shrink_to_fit();
+  drop_glyphs_.assign(capacity * max_length, 0);
+  drop_glyphs_.shrink_to_fit();
+  free_drops_.clear();
+  free_drops_.shrink_to_fit();
+  free_drops_.reserve(capacity);
+  for (int i = capacity - 1; i >= 0; --i) {
+    drops_[i].chars = &drop_glyphs_[i * max_length];
+    free_drops_.push_back(i);
+  }
+}
+
+void RainEngine::schedule_spawn(int x, uint32_t now, bool wait_interval) {
+  // The rain used to roll a 1 in drop_spawn_chance dice on every frame once
+  // the spawn interval had passed, so the number of frames until a spawn is
+  // geometrically distributed. Sample that number directly instead.
+  int frames = 0;
+  if (spawn_log_q_ < 0) {
+    float u = (rng_.next() >> 8) * (1.0f / (1 << 24)); // [0, 1)
+    frames = std::log1p(-u) / spawn_log_q_;
+  }
+  uint32_t delay = frames * config_.frame_interval_ms;
+  if (wait_interval)
+    delay += config_.drop_spawn_interval_ms + 1;
+  if (quality_.spawn_percent < 100) {
+    // Spawning less often is the same as waiting longer between spawns
+    delay = (uint64_t)delay * 100 / std::max(quality_.spawn_percent, 1);
+  }
+  timers_.schedule(spawn_timer(x), now + delay);
+}
+
+bool RainEngine::spawn_drop(int x, uint32_t now, bool is_image_drop) {
+  if (free_drops_.empty()) {
+    // The pool is exhausted
+    return false;
+  }
+  if (!is_image_drop && pool_drops() >= drop_cap_) {
+    // The layer has used up its share of the drop budget
+    return false;
+  }
+  int id = free_drops_.back();
+  free_drops_.pop_back();
+
+  auto &drop = drops_[id];
+  drop.is_image_drop = is_image_drop;
+  active_image_drops_ += is_image_drop;
+  if (is_image_drop) {
+    // Make drops extra long to ensure they cover the screen as they fall
+    drop.length = rows_;
+    drop.speed_ms = config_.image_drop_speed_ms;
+    // Start drops at random negative positions to stagger their appearance
+    drop.head_row = -(int)rng_.uniform(4);
+  } else {
+    drop.length = rng_.range(config_.min_drop_length, config_.max_drop_length);
+    drop.speed_ms = config_.min_speed_ms + rng_.uniform(config_.speed_range_ms);
+    drop.head_row = -1;
+  }
+  drop.column = x;
+  drop.active = true;
+  drop.tail = 0;
+  rng_.fill(drop.chars, drop.length, glyph_set_->size);
+
+  // Append to the column so drops are painted in the order they were spawned
+  auto &col = columns_[x];
+  drop.prev = col.last_drop;
+  drop.next = -1;
+  if (col.last_drop == -1)
+    col.first_drop = id;
+  else
+    drops_[col.last_drop].next = id;
+  col.last_drop = id;
+
+  if (on_screen(drop.head_row))
+    mark_dirty(x);
+
+  timers_.schedule(advance_timer(id), now + drop.speed_ms + 1);
+  // Mutate head character rapidly (but not for static image drops)
+  if (!is_image_drop)
+    timers_.schedule(mutate_timer(id), now + config_.head_mutate_interval_ms + 1);
+  return true;
+}
+
+void RainEngine::retire_drop(int id) {
+  auto &drop = drops_[id];
+  auto &col = columns_[drop.column];
+  if (drop.prev == -1)
+    col.first_drop = drop.next;
+  else
+    drops_[drop.prev].next = drop.next;
+  if (drop.next == -1)
+    col.last_drop = drop.prev;
+  else
+    drops_[drop.next].prev = drop.prev;
+  drop.active = false;
+  active_image_drops_ -= drop.is_image_drop;
+  mark_dirty(drop.column);
+  timers_.cancel(advance_timer(id));
+  timers_.cancel(mutate_timer(id));
+  free_drops_.push_back(id);
+}
+
+void RainEngine::on_timer(int id, uint32_t now) {
+  int num_drop_timers = drops_.size() * 2;
+  if (id >= num_drop_timers) {
+    int x = id - num_drop_timers;
+    if (!can_spawn()) {
+      // Wait for the image reveal to finish before spawning again
+      columns_[x].spawn_parked = true;
+      return;
+    }
+    spawn_drop(x, now);
+    schedule_spawn(x, now, true);
+  } else if (id == advance_timer(id / 2)) {
+    advance_drop(id / 2, now);
+  } else {
+    auto &drop = drops_[id / 2];
+    drop.glyph(0) = random_glyph();
+    // Only the head changed, so unless the column is painted anyway the
+    // new glyph goes straight into its cell
+    if (!columns_[drop.column].dirty && on_screen(drop.head_row) &&
+        !covered_by_later(id / 2, drop.head_row)) {
+      int index = drop.head_row * cols_ + drop.column;
+      cells_[index].glyph = painted_glyph(drop, 0, index);
+      refresh_key(index);
+    }
+    timers_.schedule(id, now + config_.head_mutate_interval_ms + 1);
+  }
+}
+
+void RainEngine::advance_drop(int id, uint32_t now) {
+  auto &drop = drops_[id];
+  drop.head_row++;
+
+  // Drop the tail glyph and reuse its slot for the new head glyph
+  drop.chars[drop.tail] = random_glyph();
+  drop.tail = (drop.tail + 1) % drop.length;
+
+  // If the whole drop is offscreen, it is done
+  if (drop.head_row - drop.length >= rows_) {
+    retire_drop(id);
+    return;
+  }
+  mark_dirty(drop.column);
+  timers_.schedule(advance_timer(id), now + drop.speed_ms + 1);
+}
+
+void RainEngine::paint_dirty_columns(uint32_t last_paint) {
+  for (int x : dirty_columns_) {
+    paint_column(x, last_paint);
+    columns_[x].dirty = false;
+  }
+  dirty_columns_.clear();
+}
+
+void RainEngine::paint_column(int x, uint32_t last_paint) {
+  // The drops leave the cells they covered when they were last painted: a
+  // head goes dark, and a body cell fades on from where its drop left it
+  for (int index = x; index < (int)cells_.size(); index += cols_) {
+    auto &cell = cells_[index];
+    if (cell.flags & Cell::PINNED) {
+      cell.flags &= ~Cell::PINNED;
+      cell.fade_start = last_paint - cell.fade_start;
+    } else if (cell.flags & Cell::HEAD) {
+      cell.flags &= Cell::QUEUED;
+    }
+  }
+  // Paint every drop, in the order they were spawned
+  for (int id = columns_[x].first_drop; id != -1; id = drops_[id].next) {
+    auto &drop = drops_[id];
+    for (int i = 0; i < drop.length; ++i) {
+      int row = drop.head_row - i;
+      if (!on_screen(row)) {
+        continue;
+      }
+      auto &cell = cell_at(x, row);
+      cell.glyph = painted_glyph(drop, i, row * cols_ + x);
+      if (i == 0) {
+        cell.flags = Cell::LIT | Cell::HEAD | (cell.flags & Cell::QUEUED);
+      } else {
+        // The further down the tail (higher i), the more faded the glyph is
+        cell.flags = Cell::LIT | Cell::FADING | Cell::PINNED | (cell.flags & Cell::QUEUED);
+        cell.fade_start = gradient_step_ms_ * i;
+      }
+    }
+  }
+  for (int index = x; index < (int)cells_.size(); index += cols_) {
+    auto &cell = cells_[index];
+    if ((cell.flags & (Cell::FADING | Cell::PINNED)) != Cell::FADING) {
+      refresh_key(index);
+    } else if (!(cell.flags & Cell::QUEUED)) {
+      // update_fade() sets the key
+      cell.flags |= Cell::QUEUED;
+      fading_.push_back(index);
+    }
+  }
+}
+
+uint8_t RainEngine::painted_glyph(Drop &drop, int i, int index) const {
+  // The image is shaded by the glyphs of its drops: each cell shows a glyph
+  // with as much ink as the cell is bright, varied by the drop's own glyph
+  if (drop.is_image_drop && image_mode_) {
+    return glyph_set_->glyph_for(image_brightness_map_[index], drop.glyph(i));
+  }
+  return drop.glyph(i);
+}
+
+bool RainEngine::covered_by_later(int id, int row) const {
+  // Drops spawned later are painted over this one
+  for (int other = drops_[id].next; other != -1; other = drops_[other].next) {
+    const auto &drop = drops_[other];
+    if (drop.head_row >= row && drop.head_row - drop.length < row) {
+      return true;
+    }
+  }
+  return false;
+}
+
+const RainEngine::FadeRate &RainEngine::cell_fade_rate(int index) const {
+  // Brighter pixels have a longer fade duration, see set_image_brightness()
+  if (is_revealing()) {
+    return image_fade_rates_[index];
+  }
+  return fade_rate_;
+}
+
+void RainEngine::update_fade(uint32_t now) {
+  const uint16_t now16 = now;
+  for (size_t i = 0; i < fading_.size();) {
+    const int index = fading_[i];
+    auto &cell = cells_[index];
+    if ((cell.flags & (Cell::FADING | Cell::PINNED)) == Cell::FADING) {
+      uint16_t elapsed = now16 - cell.fade_start;
+      // The image's fade rates only change how the cell looks
+      if (elapsed < fade_rate_.duration_ms) {
+        set_key(index, get_cell_key(index, now));
+        ++i;
+        continue;
+      }
+      // Fade complete, clear cell
+      cell.flags = 0;
+      set_key(index, 0);
+    }
+    // The cell is no longer fading (it was cleared or a drop covers it), and
+    // its key is up to date
+    cell.flags &= ~Cell::QUEUED;
+    fading_[i] = fading_.back();
+    fading_.pop_back();
+  }
+  fading_cells_ = fading_.size();
+}
+
+void RainEngine::init_fade() {
+  fade_rate_ = make_fade_rate(config_.fade_duration_ms);
+  gradient_step_ms_ = config_.fade_duration_ms / (config_.max_drop_length + 2);
+  // Quantize the remaining brightness at each step to one of the fade levels
+  // (1..fade_levels), and store the green value of that level.
+  int fade_levels = config_.fade_levels;
+  if (quality_.fade_levels > 0)
+    fade_levels = std::min(fade_levels, quality_.fade_levels);
+  const uint32_t levels = std::max(fade_levels, 1);
+  fade_lut_.resize(fade_steps);
+  for (uint32_t step = 0; step < fade_steps; ++step) {
+    uint32_t level = ((fade_steps - step) * levels + fade_steps - 1) / fade_steps;
+    fade_lut_[step] = level * 0xFF / levels;
+  }
+}
+
+RainEngine::FadeRate RainEngine::make_fade_rate(uint32_t duration_ms) {
+  FadeRate rate;
+  rate.duration_ms = std::clamp<uint32_t>(duration_ms, 1, UINT16_MAX);
+  rate.step_rate = ((uint32_t)fade_steps << 16) / rate.duration_ms;
+  return rate;
+}
+
+uint32_t RainEngine::get_cell_key(int index, uint32_t now) const {
+  const auto &cell = cells_[index];
+  if (!(cell.flags & Cell::LIT)) {
+    return 0;
+  }
+  // Hide very dark pixels of the image
+  if (is_revealing() && image_brightness_map_[index] < min_image_brightness_) {
+    return 0;
+  }
+  if (cell.flags & Cell::HEAD) {
+    return make_key(cell.glyph, KEY_HEAD);
+  }
+  if (!(cell.flags & Cell::FADING)) {
+    // This case is for the body of the drop, which is not the head and not fading yet.
+    return make_key(cell.glyph, KEY_BODY);
+  }
+
+  uint16_t elapsed = (uint16_t)now - cell.fade_start;
+  if (cell.flags & Cell::PINNED) {
+    // A cell this far down a drop's body has faded out before the drop moves
+    elapsed = cell.fade_start;
+    if (elapsed >= fade_rate_.duration_ms) {
+      return 0;
+    }
+  }
+  const FadeRate &rate = cell_fade_rate(index);
+  // Once faded, the cell is transparent.
+  if (elapsed >= rate.duration_ms) {
+    return 0;
+  }
+  // elapsed < duration, so this is always < fade_steps
+  uint32_t step = (elapsed * rate.step_rate) >> 16;
+  // Store the green value itself so the key can be turned back into a color
+  return make_key(cell.glyph, KEY_FADING, fade_lut_[step]);
+}
+
+void RainEngine::update_keys(uint32_t now) {
+  for (int i = 0; i < (int)keys_.size(); ++i) {
+    keys_[i] = get_cell_key(i, now);
+  }
+  all_keys_changed_ |= track_changes_;
+}
+
+void RainEngine::set_next_reveal_time(uint32_t now) {
+  uint32_t interval =
+      rng_.range(config_.image_reveal_min_interval_ms, config_.image_reveal_max_interval_ms);
+  state_transition_time_ = now + interval;
+}
+
+uint64_t RainEngine::frame_hash() const {
+  uint64_t hash = 0xCBF29CE484222325;
+  const uint32_t *frame = keys();
+  for (size_t index = 0; index < keys_.size(); ++index) {
+    uint32_t key = frame[index];
+    // Hash the glyph's codepoint rather than its index, so the recorded
+    // hashes don't depend on how the keys store the glyph
+    if (key)
+      key = (key & ~key_glyph_mask) | glyph_set_->codepoint(key_glyph(key));
+    // Hash the key bytes in a fixed order, so hashes match on any host
+    for (int i = 0; i < 4; ++i) {
+      hash ^= (key >> (8 * i)) & 0xFF;
+      hash *= 0x100000001B3;
+    }
+  }
+  return hash;
+}
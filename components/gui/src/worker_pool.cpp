@@ -0,0 +1,87 @@
+#include "worker_pool.hpp"
+
+#include <algorithm>
+#include <string>
+
+WorkerPool::WorkerPool(const Config &config) {
+  int num_workers = std::max(config.num_workers, 0);
+  seen_generation_.assign(num_workers, 0);
+  workers_.reserve(num_workers);
+  for (int i = 0; i < num_workers; ++i) {
+    int core_id = i < (int)config.core_ids.size() ? config.core_ids[i] : -1;
+    using namespace std::placeholders;
+    auto worker = std::make_unique<espp::Task>(espp::Task::Config{
+        .callback = std::bind(&WorkerPool::work, this, i, _1, _2),
+        .task_config =
+            {
+                .name = "Worker " + std::to_string(i),
+                .stack_size_bytes = config.stack_size_bytes,
+                .priority = config.priority,
+                .core_id = core_id,
+            },
+    });
+    worker->start();
+    workers_.push_back(std::move(worker));
+  }
+}
+
+WorkerPool::~WorkerPool() {
+  {
+    std::lock_guard<std::mutex> lk(job_mutex_);
+    stopping_ = true;
+  }
+  job_cv_.notify_all();
+  // Each task returns from work() on its own now, this joins them
+  workers_.clear();
+}
+
+void WorkerPool::run(int count, int chunk_size, const chunk_fn &fn) {
+  chunk_size = std::max(chunk_size, 1);
+  if (workers_.empty() || count <= chunk_size) {
+    // Not worth waking anybody up
+    fn(0, count);
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lk(job_mutex_);
+    job_fn_ = &fn;
+    job_count_ = count;
+    job_chunk_size_ = chunk_size;
+    next_item_ = 0;
+    busy_workers_ = workers_.size();
+    ++job_generation_;
+  }
+  job_cv_.notify_all();
+  run_chunks();
+  // fn (and the rest of the job) must outlive the workers' use of it
+  std::unique_lock<std::mutex> lk(job_mutex_);
+  done_cv_.wait(lk, [this] { return busy_workers_ == 0; });
+  job_fn_ = nullptr;
+}
+
+void WorkerPool::run_chunks() {
+  int begin;
+  while ((begin = next_item_.fetch_add(job_chunk_size_)) < job_count_) {
+    (*job_fn_)(begin, std::min(begin + job_chunk_size_, job_count_));
+  }
+}
+
+bool WorkerPool::work(size_t worker, std::mutex &, std::condition_variable &) {
+  {
+    std::unique_lock<std::mutex> lk(job_mutex_);
+    job_cv_.wait(lk, [&] { return stopping_ || job_generation_ != seen_generation_[worker]; });
+    if (stopping_) {
+      // Stop the task
+      return true;
+    }
+    seen_generation_[worker] = job_generation_;
+  }
+  run_chunks();
+  {
+    std::lock_guard<std::mutex> lk(job_mutex_);
+    --busy_workers_;
+  }
+  done_cv_.notify_one();
+  // Wait for the next job
+  return false;
+}
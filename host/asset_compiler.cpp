@@ -0,0 +1,430 @@
+// Converts the source images of the littlefs partition (fs/) into assets the
+// device can use without decoding anything: RGB565 pixels at the board's
+// resolution, the brightness map of the rain's grid and an index of both
+// (see AssetIndex). A top-level directory named <name>.frames holds the
+// frames of an animated image (in file name order), which become one
+// brightness map sequence (see BrightnessSequence). Every other file is
+// copied as is, and so is an image which can't be decoded here, so the device
+// can still decode it at boot.
+//
+// The output directory is replaced. It's then packed into the partition
+// image, so the tool also estimates how much of the partition it will use
+// and fails if the assets don't fit.
+//
+// Usage: asset_compiler --src DIR --out DIR --width N --height N
+//                       [--cols N] [--rows N] [--char-width N] [--line-height N]
+//                       [--frame-ms N] [--partition-size BYTES] [--keep-sources]
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include <fmt/core.h>
+
+#if MRP_HAVE_LIBJPEG
+#include <cstdio>
+#include <jpeglib.h>
+#endif
+
+#include "asset_index.hpp"
+#include "brightness_cache.hpp"
+#include "brightness_map.hpp"
+#include "brightness_sequence.hpp"
+
+namespace fs = std::filesystem;
+
+struct Options {
+  fs::path src;
+  fs::path out;
+  int width = 0;
+  int height = 0;
+  int cols = 0; // 0: width / char_width, like MatrixRain
+  int rows = 0; // 0: height / line_height rounded up, like MatrixRain
+  int char_width = 8;
+  int line_height = 15; // line height of unscii_8_jp, which sets the rain's rows
+  int frame_ms = 100; // time each frame of a sequence is shown
+  size_t partition_size = 0; // 0: don't check
+  bool keep_sources = false;
+};
+
+/// An 8 bit RGB image, R, G, B bytes per pixel.
+struct Rgb888 {
+  int width = 0;
+  int height = 0;
+  std::vector<uint8_t> pixels;
+};
+
+static void print_usage(const char *name) {
+  fmt::print("Usage: {} --src DIR --out DIR --width N --height N [--cols N] [--rows N] "
+             "[--char-width N] [--line-height N] [--frame-ms N] [--partition-size BYTES] "
+             "[--keep-sources]\n",
+             name);
+}
+
+static bool parse_args(int argc, char **argv, Options &options) {
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--keep-sources") {
+      options.keep_sources = true;
+      continue;
+    }
+    if (i + 1 >= argc) {
+      return false;
+    }
+    const char *value = argv[++i];
+    if (arg == "--src")
+      options.src = value;
+    else if (arg == "--out")
+      options.out = value;
+    else if (arg == "--width")
+      options.width = std::strtol(value, nullptr, 0);
+    else if (arg == "--height")
+      options.height = std::strtol(value, nullptr, 0);
+    else if (arg == "--cols")
+      options.cols = std::strtol(value, nullptr, 0);
+    else if (arg == "--rows")
+      options.rows = std::strtol(value, nullptr, 0);
+    else if (arg == "--char-width")
+      options.char_width = std::strtol(value, nullptr, 0);
+    else if (arg == "--line-height")
+      options.line_height = std::strtol(value, nullptr, 0);
+    else if (arg == "--frame-ms")
+      options.frame_ms = std::strtol(value, nullptr, 0);
+    else if (arg == "--partition-size")
+      options.partition_size = std::strtoul(value, nullptr, 0);
+    else
+      return false;
+  }
+  if (options.src.empty() || options.out.empty() || options.width <= 0 || options.height <= 0 ||
+      options.char_width <= 0 || options.line_height <= 0 || options.frame_ms <= 0 ||
+      options.frame_ms > UINT16_MAX) {
+    return false;
+  }
+  if (options.cols <= 0)
+    options.cols = options.width / options.char_width;
+  if (options.rows <= 0)
+    options.rows = std::ceil(options.height / (float)options.line_height);
+  return options.cols > 0 && options.rows > 0 && options.cols <= UINT16_MAX &&
+         options.rows <= UINT16_MAX;
+}
+
+// Reads a binary PPM (P6) with 8 bit channels
+static bool decode_ppm(const fs::path &file, Rgb888 &image) {
+  std::ifstream stream(file, std::ios::binary);
+  std::string magic;
+  int max_value = 0;
+  stream >> magic;
+  // Skip comments between the header fields
+  auto next_field = [&](int &value) {
+    while (stream >> std::ws && stream.peek() == '#') {
+      stream.ignore(4096, '\n');
+    }
+    stream >> value;
+  };
+  next_field(image.width);
+  next_field(image.height);
+  next_field(max_value);
+  stream.get(); // the single whitespace before the pixels
+  if (!stream || magic != "P6" || max_value != 255 || image.width <= 0 || image.height <= 0) {
+    return false;
+  }
+  image.pixels.resize((size_t)image.width * image.height * 3);
+  return (bool)stream.read((char *)image.pixels.data(), image.pixels.size());
+}
+
+#if MRP_HAVE_LIBJPEG
+static bool decode_jpeg(const fs::path &file, Rgb888 &image) {
+  FILE *input = fopen(file.c_str(), "rb");
+  if (!input) {
+    return false;
+  }
+  jpeg_decompress_struct cinfo;
+  jpeg_error_mgr jerr;
+  cinfo.err = jpeg_std_error(&jerr);
+  jpeg_create_decompress(&cinfo);
+  jpeg_stdio_src(&cinfo, input);
+  bool ok = jpeg_read_header(&cinfo, TRUE) == JPEG_HEADER_OK;
+  if (ok) {
+    cinfo.out_color_space = JCS_RGB;
+    jpeg_start_decompress(&cinfo);
+    image.width = cinfo.output_width;
+    image.height = cinfo.output_height;
+    image.pixels.resize((size_t)image.width * image.height * 3);
+    while (cinfo.output_scanline < cinfo.output_height) {
+      JSAMPROW row = &image.pixels[(size_t)cinfo.output_scanline * image.width * 3];
+      jpeg_read_scanlines(&cinfo, &row, 1);
+    }
+    jpeg_finish_decompress(&cinfo);
+  }
+  jpeg_destroy_decompress(&cinfo);
+  fclose(input);
+  return ok;
+}
+#endif
+
+static bool decode_image(const fs::path &file, Rgb888 &image) {
+  std::string extension = file.extension().string();
+  std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+  if (extension == ".ppm") {
+    return decode_ppm(file, image);
+  }
+#if MRP_HAVE_LIBJPEG
+  if (extension == ".jpg" || extension == ".jpeg") {
+    return decode_jpeg(file, image);
+  }
+#endif
+  return false;
+}
+
+// Stretches the image over width x height pixels, like the rain stretches it
+// over its grid. Each output pixel is the average of the source pixels it
+// covers (or the nearest one when scaling up).
+static std::vector<uint16_t> to_rgb565(const Rgb888 &image, int width, int height) {
+  std::vector<uint16_t> pixels((size_t)width * height);
+  const float x_scale = (float)image.width / width;
+  const float y_scale = (float)image.height / height;
+  for (int y = 0; y < height; ++y) {
+    int y0 = std::min<int>(y * y_scale, image.height - 1);
+    int y1 = std::clamp<int>((y + 1) * y_scale, y0 + 1, image.height);
+    for (int x = 0; x < width; ++x) {
+      int x0 = std::min<int>(x * x_scale, image.width - 1);
+      int x1 = std::clamp<int>((x + 1) * x_scale, x0 + 1, image.width);
+      uint32_t sum[3] = {0, 0, 0};
+      for (int sy = y0; sy < y1; ++sy) {
+        const uint8_t *src = &image.pixels[((size_t)sy * image.width + x0) * 3];
+        for (int sx = x0; sx < x1; ++sx, src += 3) {
+          sum[0] += src[0];
+          sum[1] += src[1];
+          sum[2] += src[2];
+        }
+      }
+      uint32_t count = (x1 - x0) * (y1 - y0);
+      uint32_t r = (sum[0] + count / 2) / count;
+      uint32_t g = (sum[1] + count / 2) / count;
+      uint32_t b = (sum[2] + count / 2) / count;
+      pixels[(size_t)y * width + x] = ((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3);
+    }
+  }
+  return pixels;
+}
+
+static bool write_rgb565(const fs::path &file, const std::vector<uint16_t> &pixels) {
+  // Native (little endian) byte order, like LV_COLOR_FORMAT_RGB565
+  std::vector<uint8_t> bytes(pixels.size() * 2);
+  for (size_t i = 0; i < pixels.size(); ++i) {
+    bytes[2 * i] = pixels[i] & 0xFF;
+    bytes[2 * i + 1] = pixels[i] >> 8;
+  }
+  std::ofstream stream(file, std::ios::binary | std::ios::trunc);
+  stream.write((const char *)bytes.data(), bytes.size());
+  return (bool)stream;
+}
+
+// The map is computed from the RGB565 asset, so it's the same map the device
+// computes if it ever has to fall back to the asset itself
+static void compute_brightness_map(const Options &options, const std::vector<uint16_t> &pixels,
+                                   uint8_t *brightness_map) {
+  BrightnessMap::Image rgb565{
+      .format = BrightnessMap::Format::RGB565,
+      .width = options.width,
+      .height = options.height,
+      .stride = 0,
+      .pixels = (const uint8_t *)pixels.data(),
+      .palette = nullptr,
+  };
+  // Every map has the same size, so the buffers are only allocated once
+  static BrightnessMap mapper;
+  mapper.compute(rgb565, options.cols, options.rows, brightness_map);
+}
+
+static bool compile_image(const Options &options, const fs::path &file, const fs::path &asset_dir,
+                          AssetIndex &index) {
+  Rgb888 image;
+  if (!decode_image(file, image)) {
+    return false;
+  }
+  const std::string name = file.stem().string();
+  const uint64_t source_hash = BrightnessCache::hash_file(file);
+
+  AssetIndex::Entry image_entry{
+      .kind = AssetIndex::Kind::IMAGE,
+      .name = name,
+      .file = name + ".rgb565",
+      .width = (uint16_t)options.width,
+      .height = (uint16_t)options.height,
+      .source_hash = source_hash,
+  };
+  auto pixels = to_rgb565(image, options.width, options.height);
+  if (!write_rgb565(asset_dir / image_entry.file, pixels)) {
+    fmt::print("Couldn't write {}\n", (asset_dir / image_entry.file).string());
+    return false;
+  }
+  index.add(image_entry);
+
+  std::vector<uint8_t> brightness_map((size_t)options.cols * options.rows);
+  compute_brightness_map(options, pixels, brightness_map.data());
+  BrightnessCache cache(asset_dir);
+  BrightnessCache::Key key{
+      .source_hash = source_hash,
+      .cols = (uint16_t)options.cols,
+      .rows = (uint16_t)options.rows,
+      .format = (uint8_t)BrightnessMap::Format::RGB565,
+  };
+  if (!cache.store(key, brightness_map)) {
+    return false;
+  }
+  index.add({
+      .kind = AssetIndex::Kind::BMAP,
+      .name = name,
+      .file = cache.path_for(key).filename().string(),
+      .width = key.cols,
+      .height = key.rows,
+      .source_hash = source_hash,
+  });
+  fmt::print("  {} ({}x{}) -> {} ({}x{}), {} ({}x{} grid)\n", file.filename().string(),
+             image.width, image.height, image_entry.file, options.width, options.height,
+             index.entries().back().file, options.cols, options.rows);
+  return true;
+}
+
+static bool compile_sequence(const Options &options, const fs::path &dir,
+                             const fs::path &asset_dir, AssetIndex &index) {
+  std::vector<fs::path> files;
+  for (const auto &entry : fs::directory_iterator(dir)) {
+    if (entry.is_regular_file()) {
+      files.push_back(entry.path());
+    }
+  }
+  std::sort(files.begin(), files.end());
+  if (files.empty() || files.size() > UINT16_MAX) {
+    return false;
+  }
+
+  // Only the brightness maps are kept, one frame after the other
+  const size_t frame_size = (size_t)options.cols * options.rows;
+  std::vector<uint8_t> frames(files.size() * frame_size);
+  uint64_t source_hash = 0xCBF29CE484222325;
+  for (size_t i = 0; i < files.size(); ++i) {
+    Rgb888 image;
+    if (!decode_image(files[i], image)) {
+      fmt::print("Couldn't decode frame {}\n", files[i].string());
+      return false;
+    }
+    auto pixels = to_rgb565(image, options.width, options.height);
+    compute_brightness_map(options, pixels, &frames[i * frame_size]);
+    source_hash = (source_hash ^ BrightnessCache::hash_file(files[i])) * 0x100000001B3;
+  }
+
+  const std::string name = dir.stem().string();
+  BrightnessSequence::Header header{
+      .cols = (uint16_t)options.cols,
+      .rows = (uint16_t)options.rows,
+      .num_frames = (uint16_t)files.size(),
+      .frame_interval_ms = (uint16_t)options.frame_ms,
+  };
+  AssetIndex::Entry entry{
+      .kind = AssetIndex::Kind::BMSEQ,
+      .name = name,
+      .file = fmt::format("{}-{}x{}.bmseq", name, options.cols, options.rows),
+      .width = header.cols,
+      .height = header.rows,
+      .source_hash = source_hash,
+  };
+  if (!BrightnessSequence::write(asset_dir / entry.file, header, frames)) {
+    fmt::print("Couldn't write {}\n", (asset_dir / entry.file).string());
+    return false;
+  }
+  index.add(entry);
+  fmt::print("  {}/ ({} frames) -> {} ({}x{} grid, {} ms per frame)\n", dir.filename().string(),
+             files.size(), entry.file, options.cols, options.rows, options.frame_ms);
+  return true;
+}
+
+// Estimates the littlefs blocks used by a directory tree: a metadata pair for
+// the superblock and for every directory, and whole blocks for every file.
+static size_t estimate_blocks(const fs::path &dir, size_t block_size) {
+  size_t blocks = 2;
+  for (const auto &entry : fs::recursive_directory_iterator(dir)) {
+    if (entry.is_directory()) {
+      blocks += 2;
+    } else if (entry.is_regular_file()) {
+      blocks += std::max<size_t>((entry.file_size() + block_size - 1) / block_size, 1);
+    }
+  }
+  return blocks;
+}
+
+int main(int argc, char **argv) {
+  Options options;
+  if (!parse_args(argc, argv, options)) {
+    print_usage(argv[0]);
+    return 1;
+  }
+  if (!fs::is_directory(options.src)) {
+    fmt::print("Source directory {} doesn't exist\n", options.src.string());
+    return 1;
+  }
+
+  std::error_code ec;
+  fs::remove_all(options.out, ec);
+  const fs::path asset_dir = options.out / "assets";
+  fs::create_directories(asset_dir, ec);
+  if (ec) {
+    fmt::print("Couldn't create {}: {}\n", asset_dir.string(), ec.message());
+    return 1;
+  }
+
+  fmt::print("Compiling assets for {}x{} ({}x{} grid)\n", options.width, options.height,
+             options.cols, options.rows);
+  AssetIndex index;
+  std::vector<fs::path> compiled_dirs;
+  for (const auto &entry : fs::directory_iterator(options.src)) {
+    if (entry.is_directory() && entry.path().extension() == ".frames" &&
+        compile_sequence(options, entry.path(), asset_dir, index)) {
+      compiled_dirs.push_back(entry.path().filename());
+    }
+  }
+  for (const auto &entry : fs::recursive_directory_iterator(options.src)) {
+    if (!entry.is_regular_file()) {
+      continue;
+    }
+    const fs::path relative = fs::relative(entry.path(), options.src);
+    // Only images at the top level are compiled, their names are unique
+    bool compiled = relative.parent_path().empty()
+                        ? compile_image(options, entry.path(), asset_dir, index)
+                        : std::find(compiled_dirs.begin(), compiled_dirs.end(),
+                                    *relative.begin()) != compiled_dirs.end();
+    if (compiled && !options.keep_sources) {
+      continue;
+    }
+    fs::create_directories((options.out / relative).parent_path(), ec);
+    if (!fs::copy_file(entry.path(), options.out / relative, fs::copy_options::overwrite_existing,
+                       ec)) {
+      fmt::print("Couldn't copy {}: {}\n", relative.string(), ec.message());
+      return 1;
+    }
+    fmt::print("  {} (copied)\n", relative.string());
+  }
+  if (!index.save(asset_dir / AssetIndex::file_name)) {
+    fmt::print("Couldn't write the asset index\n");
+    return 1;
+  }
+
+  if (options.partition_size) {
+    static constexpr size_t block_size = 4096;
+    size_t used = estimate_blocks(options.out, block_size) * block_size;
+    fmt::print("Assets use about {} of {} bytes ({:.1f}%) of the partition\n", used,
+               options.partition_size, 100.0f * used / options.partition_size);
+    if (used > options.partition_size) {
+      fmt::print("The assets don't fit in the partition!\n");
+      return 1;
+    }
+  }
+  return 0;
+}
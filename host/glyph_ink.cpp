@@ -0,0 +1,114 @@
+// Lists the codepoints of a font converted by lv_font_conv (1 bpp,
+// uncompressed) and counts the lit pixels of each glyph's bitmap, and prints
+// them as the font_codepoints and font_ink tables of
+// components/gui/include/glyph_ink.hpp. Glyph sets are checked against these
+// tables at compile time (see GlyphSet).
+//
+// Usage: glyph_ink FONT.c                 print the header
+//        glyph_ink FONT.c --check HEADER  fail if HEADER is out of date
+
+#include <bit>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+
+#include <fmt/core.h>
+
+// lv_font_conv writes each glyph's bitmap after a /* U+XXXX "c" */ comment,
+// so the bytes up to the next comment are that glyph's (padding bits are 0).
+static bool count_ink(const std::string &font_file, std::map<uint32_t, int> &ink) {
+  std::ifstream stream(font_file);
+  if (!stream.is_open()) {
+    fmt::print(stderr, "Couldn't open {}\n", font_file);
+    return false;
+  }
+  std::string line;
+  bool in_bitmap = false;
+  int64_t codepoint = -1;
+  while (std::getline(stream, line)) {
+    if (!in_bitmap) {
+      in_bitmap = line.find("glyph_bitmap[]") != std::string::npos;
+      continue;
+    }
+    auto comment = line.find("/* U+");
+    if (comment != std::string::npos) {
+      codepoint = std::strtol(line.c_str() + comment + 5, nullptr, 16);
+      ink[codepoint] = 0;
+      continue;
+    }
+    for (size_t pos = line.find("0x"); pos != std::string::npos; pos = line.find("0x", pos + 2)) {
+      if (codepoint >= 0) {
+        ink[codepoint] += std::popcount((uint32_t)std::strtoul(line.c_str() + pos, nullptr, 16));
+      }
+    }
+    if (line.find("};") != std::string::npos) {
+      break;
+    }
+  }
+  return true;
+}
+
+// Prints a table of the glyphs' values, 16 per line
+template <typename T>
+static std::string make_table(const char *type, const char *name,
+                              const std::map<uint32_t, int> &ink, T value) {
+  std::string table =
+      fmt::format("inline constexpr std::array<{}, {}> {} = {{", type, ink.size(), name);
+  int i = 0;
+  for (auto it = ink.begin(); it != ink.end(); ++it, ++i) {
+    table += fmt::format("{}{},", i % 16 ? " " : "\n    ", value(*it));
+  }
+  table += "\n};\n";
+  return table;
+}
+
+static std::string make_header(const std::map<uint32_t, int> &ink) {
+  std::string header = "#pragma once\n"
+                       "\n"
+                       "// Generated by host/glyph_ink.cpp from components/gui/src/UNSCII_8_JP.c, do\n"
+                       "// not edit. The host build checks that it is up to date.\n"
+                       "\n"
+                       "#include <array>\n"
+                       "#include <cstdint>\n"
+                       "\n"
+                       "/// Codepoints of every glyph of unscii_8_jp, in ascending order.\n";
+  header += make_table("uint32_t", "font_codepoints", ink,
+                       [](const auto &glyph) { return fmt::format("0x{:04X}", glyph.first); });
+  header += "\n"
+            "/// Number of lit pixels in the bitmap of each glyph of font_codepoints.\n";
+  header += make_table("uint8_t", "font_ink", ink,
+                       [](const auto &glyph) { return fmt::format("{}", glyph.second); });
+  return header;
+}
+
+int main(int argc, char **argv) {
+  if (argc != 2 && !(argc == 4 && std::string(argv[2]) == "--check")) {
+    fmt::print(stderr, "Usage: {} FONT.c [--check HEADER]\n", argv[0]);
+    return 1;
+  }
+  std::map<uint32_t, int> ink;
+  if (!count_ink(argv[1], ink)) {
+    return 1;
+  }
+  if (ink.empty()) {
+    fmt::print(stderr, "{} has no glyph bitmaps\n", argv[1]);
+    return 1;
+  }
+  std::string header = make_header(ink);
+  if (argc == 2) {
+    fmt::print("{}", header);
+    return 0;
+  }
+  std::ifstream stream(argv[3]);
+  std::stringstream current;
+  current << stream.rdbuf();
+  if (current.str() != header) {
+    fmt::print(stderr, "{} is out of date, regenerate it with:\n  glyph_ink {} > {}\n", argv[3],
+               argv[1], argv[3]);
+    return 1;
+  }
+  return 0;
+}
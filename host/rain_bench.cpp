@@ -0,0 +1,166 @@
+// Runs the matrix rain simulation for a number of simulated seconds and
+// reports how long each frame took, how many drops were falling and how many
+// heap allocations each frame made. With --image, it also times computing
+// the brightness map of a screen-sized RGB565 image, which is what swapping
+// the image costs. With --layers, the rain has depth layers behind it, and
+// the drops across all of them are capped at the drop budget.
+//
+// Usage: rain_bench [--seconds N] [--cols N] [--rows N] [--frame-ms N]
+//                   [--seed N] [--image] [--layers N] [--drop-budget N]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+
+#include <fmt/core.h>
+
+#include "brightness_map.hpp"
+#include "rain_engine.hpp"
+#include "test_image.hpp"
+
+static size_t num_allocations = 0;
+
+void *operator new(std::size_t size) {
+  ++num_allocations;
+  if (void *ptr = std::malloc(size ? size : 1))
+    return ptr;
+  throw std::bad_alloc();
+}
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+void operator delete(void *ptr, std::size_t) noexcept { std::free(ptr); }
+
+struct Options {
+  int seconds = 60;
+  int cols = 16;
+  int rows = 9;
+  int frame_ms = 30;
+  uint32_t seed = 1;
+  bool image = false;
+  int layers = 0;
+  int drop_budget = 0;
+};
+
+static void print_usage(const char *name) {
+  fmt::print("Usage: {} [--seconds N] [--cols N] [--rows N] [--frame-ms N] [--seed N] "
+             "[--image] [--layers N] [--drop-budget N]\n",
+             name);
+}
+
+static bool parse_args(int argc, char **argv, Options &options) {
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--image") {
+      options.image = true;
+      continue;
+    }
+    if (i + 1 >= argc) {
+      return false;
+    }
+    long value = std::strtol(argv[++i], nullptr, 0);
+    if (arg == "--seconds")
+      options.seconds = value;
+    else if (arg == "--cols")
+      options.cols = value;
+    else if (arg == "--rows")
+      options.rows = value;
+    else if (arg == "--frame-ms")
+      options.frame_ms = value;
+    else if (arg == "--seed")
+      options.seed = value;
+    else if (arg == "--layers")
+      options.layers = value;
+    else if (arg == "--drop-budget")
+      options.drop_budget = value;
+    else
+      return false;
+  }
+  return options.seconds > 0 && options.cols > 0 && options.rows > 0 && options.frame_ms > 0 &&
+         options.layers >= 0 && options.drop_budget >= 0;
+}
+
+int main(int argc, char **argv) {
+  Options options;
+  if (!parse_args(argc, argv, options)) {
+    print_usage(argv[0]);
+    return 1;
+  }
+
+  uint32_t now = 0;
+  RainEngine::Config config;
+  // The same scaling the Gui uses, for 8 pixel tall characters
+  static_cast<RainEngine::Params &>(config) = RainEngine::scaled_params(options.rows * 15 / 8);
+  config.frame_interval_ms = options.frame_ms;
+  config.layers = RainEngine::depth_layers(config, options.layers);
+  config.drop_budget = options.drop_budget;
+  config.seed = options.seed;
+  config.cols = options.cols;
+  config.rows = options.rows;
+  config.clock = [&now] { return now; };
+  RainEngine engine(config);
+  if (options.image) {
+    engine.set_image_brightness(make_test_image(options.cols, options.rows));
+  }
+
+  const int num_frames = options.seconds * 1000 / options.frame_ms;
+  size_t total_drops = 0;
+  size_t total_layer_drops = 0;
+  size_t total_fading = 0;
+  int peak_drops = 0;
+  size_t allocations_before = num_allocations;
+  auto start = std::chrono::steady_clock::now();
+  for (int frame = 0; frame < num_frames; ++frame) {
+    now += options.frame_ms;
+    engine.update();
+    auto stats = engine.stats();
+    total_drops += stats.active_drops;
+    total_layer_drops += stats.active_layer_drops;
+    total_fading += stats.fading_cells;
+    peak_drops = std::max(peak_drops, stats.active_drops);
+  }
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  size_t allocations = num_allocations - allocations_before;
+
+  double ns = std::chrono::duration<double, std::nano>(elapsed).count();
+  fmt::print("grid:              {}x{} cells, {} ms frames, seed {}{}\n", options.cols,
+             options.rows, options.frame_ms, options.seed, options.image ? ", image" : "");
+  fmt::print("frames:            {} ({} simulated seconds)\n", num_frames, options.seconds);
+  fmt::print("ns/frame:          {:.1f}\n", ns / num_frames);
+  fmt::print("drops/frame:       {:.2f} (peak {}, pool {})\n", (double)total_drops / num_frames,
+             peak_drops, engine.max_drops());
+  if (options.layers > 0) {
+    fmt::print("layers:            {} ({:.2f} drops/frame), drop budget {}\n", options.layers,
+               (double)total_layer_drops / num_frames, engine.drop_budget());
+  }
+  fmt::print("fading/frame:      {:.2f}\n", (double)total_fading / num_frames);
+  fmt::print("allocations/frame: {:.3f} ({} total)\n", (double)allocations / num_frames,
+             allocations);
+
+  if (options.image) {
+    // A 128x128 RGB565 gradient, like the decoded smith.jpg
+    constexpr int size = 128;
+    constexpr int iterations = 1000;
+    std::vector<uint16_t> pixels(size * size);
+    for (int i = 0; i < size * size; ++i) {
+      pixels[i] = (i * 2654435761u) >> 16;
+    }
+    BrightnessMap::Image image;
+    image.format = BrightnessMap::Format::RGB565;
+    image.width = size;
+    image.height = size;
+    image.pixels = reinterpret_cast<const uint8_t *>(pixels.data());
+    std::vector<uint8_t> brightness_map(options.cols * options.rows);
+    BrightnessMap mapper;
+    auto map_start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+      mapper.compute(image, options.cols, options.rows, brightness_map.data());
+    }
+    auto map_elapsed = std::chrono::steady_clock::now() - map_start;
+    fmt::print("image map:         {:.2f} us ({}x{} RGB565)\n",
+               std::chrono::duration<double, std::micro>(map_elapsed).count() / iterations, size,
+               size);
+  }
+  return 0;
+}
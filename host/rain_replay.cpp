@@ -0,0 +1,178 @@
+// Replays scripted runs of the matrix rain and compares the hash of every
+// frame against the golden sequences stored in host/golden. Run it after any
+// change to the rain which is not meant to change what is drawn; a mismatch
+// names the script and the first frame which differs.
+//
+// Usage: rain_replay [--record] [--golden-dir DIR] [SCRIPT...]
+//   --record          Write the golden sequences instead of checking them
+//   --golden-dir DIR  Directory of the golden sequences (default: host/golden)
+//   SCRIPT            Only replay the named scripts (default: all)
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <fmt/core.h>
+
+#include "rain_replay.hpp"
+#include "test_image.hpp"
+
+#ifndef RAIN_GOLDEN_DIR
+#define RAIN_GOLDEN_DIR "golden"
+#endif
+
+// Scripts are sized like the real screens: 128 / 8 = 16 columns and
+// ceil(128 / 15) = 9 rows of the unscii_8_jp font.
+static RainReplay::Script make_script(const std::string &name, int cols, int rows, uint32_t seed) {
+  RainReplay::Script script;
+  script.name = name;
+  // Scale the parameters like the Gui does, for 8 pixel tall characters
+  static_cast<RainEngine::Params &>(script.config) = RainEngine::scaled_params(rows * 15 / 8);
+  script.config.cols = cols;
+  script.config.rows = rows;
+  script.config.seed = seed;
+  return script;
+}
+
+static std::vector<RainReplay::Script> make_scripts() {
+  std::vector<RainReplay::Script> scripts;
+
+  // Plain rain at a steady frame rate
+  auto rain = make_script("rain_16x9", 16, 9, 1);
+  rain.segments = {{700, 30}};
+  scripts.push_back(rain);
+
+  // Irregular frames, including frames shorter than a timer wheel slot and a
+  // stall longer than the whole wheel
+  auto jitter = make_script("jitter_16x9", 16, 9, 2);
+  jitter.start_tick = 12345;
+  jitter.segments = {{100, 16}, {50, 45}, {40, 1}, {1, 1500}, {200, 30}, {3, 250}, {100, 33}};
+  scripts.push_back(jitter);
+
+  // The image reveal cycle: clearing, revealing, erasing and back to rain
+  auto image = make_script("image_16x9", 16, 9, 3);
+  image.image_brightness = make_test_image(16, 9);
+  image.min_image_brightness = 20;
+  image.segments = {{1500, 30}};
+  scripts.push_back(image);
+
+  // A larger grid, with the drop pool sized by the engine
+  auto large = make_script("rain_40x30", 40, 30, 4);
+  large.image_brightness = make_test_image(40, 30);
+  large.segments = {{400, 30}};
+  scripts.push_back(large);
+
+  // Two depth layers composited behind the rain, through an image reveal,
+  // with a drop budget tight enough to cap every layer
+  auto layers = make_script("layers_40x30", 40, 30, 5);
+  layers.config.layers = RainEngine::depth_layers(layers.config, 2);
+  layers.config.drop_budget = 40;
+  layers.image_brightness = make_test_image(40, 30);
+  layers.min_image_brightness = 20;
+  layers.segments = {{1200, 30}};
+  scripts.push_back(layers);
+
+  return scripts;
+}
+
+static std::string golden_path(const std::string &dir, const std::string &name) {
+  return dir + "/" + name + ".txt";
+}
+
+static bool write_golden(const std::string &path, const RainReplay::Script &script,
+                         const std::vector<RainReplay::Frame> &frames) {
+  FILE *file = fopen(path.c_str(), "w");
+  if (!file) {
+    fmt::print("Couldn't open {} for writing\n", path);
+    return false;
+  }
+  fmt::print(file, "# rain_replay golden sequence: {}\n", script.name);
+  fmt::print(file, "# frame tick hash\n");
+  for (size_t i = 0; i < frames.size(); ++i) {
+    fmt::print(file, "{} {} {:016x}\n", i, frames[i].tick, frames[i].hash);
+  }
+  fclose(file);
+  return true;
+}
+
+static bool read_golden(const std::string &path, std::vector<RainReplay::Frame> &frames) {
+  FILE *file = fopen(path.c_str(), "r");
+  if (!file) {
+    fmt::print("Couldn't open {}, record it with --record\n", path);
+    return false;
+  }
+  char line[128];
+  while (fgets(line, sizeof(line), file)) {
+    if (line[0] == '#')
+      continue;
+    size_t index;
+    RainReplay::Frame frame;
+    if (sscanf(line, "%zu %" SCNu32 " %" SCNx64, &index, &frame.tick, &frame.hash) != 3) {
+      fmt::print("Malformed line in {}: {}", path, line);
+      fclose(file);
+      return false;
+    }
+    frames.push_back(frame);
+  }
+  fclose(file);
+  return true;
+}
+
+static bool check_golden(const std::string &path, const std::vector<RainReplay::Frame> &frames) {
+  std::vector<RainReplay::Frame> golden;
+  if (!read_golden(path, golden))
+    return false;
+  size_t num_frames = std::min(frames.size(), golden.size());
+  for (size_t i = 0; i < num_frames; ++i) {
+    if (frames[i].tick != golden[i].tick || frames[i].hash != golden[i].hash) {
+      fmt::print("  frame {} differs: tick {} hash {:016x}, expected tick {} hash {:016x}\n", i,
+                 frames[i].tick, frames[i].hash, golden[i].tick, golden[i].hash);
+      return false;
+    }
+  }
+  if (frames.size() != golden.size()) {
+    fmt::print("  {} frames, expected {}\n", frames.size(), golden.size());
+    return false;
+  }
+  return true;
+}
+
+int main(int argc, char **argv) {
+  bool record = false;
+  std::string golden_dir = RAIN_GOLDEN_DIR;
+  std::vector<std::string> names;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--record") {
+      record = true;
+    } else if (arg == "--golden-dir" && i + 1 < argc) {
+      golden_dir = argv[++i];
+    } else if (arg.rfind("--", 0) == 0) {
+      fmt::print("Usage: {} [--record] [--golden-dir DIR] [SCRIPT...]\n", argv[0]);
+      return 1;
+    } else {
+      names.push_back(arg);
+    }
+  }
+
+  int num_failed = 0;
+  int num_run = 0;
+  for (const auto &script : make_scripts()) {
+    if (!names.empty() && std::find(names.begin(), names.end(), script.name) == names.end())
+      continue;
+    ++num_run;
+    auto frames = RainReplay::run(script);
+    auto path = golden_path(golden_dir, script.name);
+    bool ok = record ? write_golden(path, script, frames) : check_golden(path, frames);
+    fmt::print("{:<12} {} ({} frames)\n", script.name,
+               ok ? (record ? "recorded" : "ok") : "FAILED", frames.size());
+    num_failed += !ok;
+  }
+  if (num_run == 0) {
+    fmt::print("No scripts to replay\n");
+    return 1;
+  }
+  return num_failed ? 1 : 0;
+}
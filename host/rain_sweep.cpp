@@ -0,0 +1,79 @@
+// Runs the matrix rain at every screen resolution and font size of the sweep
+// (see RainSweep) and prints what it costs at each: the time to simulate a
+// frame, the drops falling, the memory of the engine and the renderers and
+// the bytes flushed per frame. The device prints the same table at boot with
+// CONFIG_MRP_RAIN_BENCH_SWEEP.
+//
+// Usage: rain_sweep [--seconds N] [--frame-ms N] [--seed N] [--layers N]
+//                   [WIDTHxHEIGHT...]
+//   WIDTHxHEIGHT  Only sweep these resolutions (default: all of RainSweep)
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include <fmt/core.h>
+
+#include "rain_sweep.hpp"
+
+struct Options {
+  int seconds = 60;
+  RainSweep::Options sweep;
+  std::vector<RainSweep::Case> cases;
+};
+
+static void print_usage(const char *name) {
+  fmt::print("Usage: {} [--seconds N] [--frame-ms N] [--seed N] [--layers N] "
+             "[WIDTHxHEIGHT...]\n",
+             name);
+}
+
+static bool parse_args(int argc, char **argv, Options &options) {
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    int width, height;
+    if (sscanf(arg.c_str(), "%dx%d", &width, &height) == 2) {
+      if (width <= 0 || height <= 0)
+        return false;
+      for (const auto &font : RainSweep::fonts) {
+        options.cases.push_back({width, height, font});
+      }
+      continue;
+    }
+    if (i + 1 >= argc) {
+      return false;
+    }
+    long value = std::strtol(argv[++i], nullptr, 0);
+    if (arg == "--seconds")
+      options.seconds = value;
+    else if (arg == "--frame-ms")
+      options.sweep.frame_ms = value;
+    else if (arg == "--seed")
+      options.sweep.seed = value;
+    else if (arg == "--layers")
+      options.sweep.layers = value;
+    else
+      return false;
+  }
+  if (options.cases.empty())
+    options.cases = RainSweep::default_cases();
+  options.sweep.frames = options.seconds * 1000 / std::max(options.sweep.frame_ms, 1);
+  return options.seconds > 0 && options.sweep.frame_ms > 0 && options.sweep.layers >= 0;
+}
+
+int main(int argc, char **argv) {
+  Options options;
+  if (!parse_args(argc, argv, options)) {
+    print_usage(argv[0]);
+    return 1;
+  }
+
+  fmt::print("{} frames of {} ms per case, seed {}, {} depth layers\n", options.sweep.frames,
+             options.sweep.frame_ms, options.sweep.seed, options.sweep.layers);
+  fmt::print("{}\n", RainSweep::header());
+  for (const auto &sweep_case : options.cases) {
+    fmt::print("{}\n", RainSweep::format(RainSweep::run(sweep_case, options.sweep)));
+  }
+  return 0;
+}
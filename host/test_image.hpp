@@ -0,0 +1,22 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+/// @brief Returns a synthetic brightness map for the image reveal: a bright
+///        disc in the middle of the grid, fading out towards the edges.
+inline std::vector<uint8_t> make_test_image(int cols, int rows) {
+  std::vector<uint8_t> brightness(cols * rows);
+  float cx = (cols - 1) / 2.0f;
+  float cy = (rows - 1) / 2.0f;
+  float radius = std::min(cols, rows) / 2.0f;
+  for (int y = 0; y < rows; ++y) {
+    for (int x = 0; x < cols; ++x) {
+      float d = std::hypot(x - cx, y - cy) / radius;
+      brightness[y * cols + x] = d >= 1.0f ? 0 : (uint8_t)(255 * (1.0f - d));
+    }
+  }
+  return brightness;
+}
@@ -1,6 +1,9 @@
 #include <chrono>
+#include <fstream>
 #include <thread>
 
+#include "asset_index.hpp"
+#include "brightness_cache.hpp"
 #include "gui.hpp"
 #include "lvgl.h"
 
@@ -23,6 +26,11 @@ using Bsp = espp::WsS3Touch;
 
 #include "jpeg.hpp"
 
+#if CONFIG_MRP_RAIN_BENCH_SWEEP
+#include "esp_heap_caps.h"
+#include "rain_sweep.hpp"
+#endif
+
 namespace fs = std::filesystem;
 using namespace std::chrono_literals;
 
@@ -30,6 +38,112 @@ static Jpeg decoder;
 
 static std::recursive_mutex lvgl_mutex;
 
+// Sets the image of the rain from the littlefs partition, without decoding
+// anything if it can help it. In order, it uses:
+//  - the animated image compiled from <name>.frames/ for this grid,
+//  - the brightness map compiled into the partition for this grid,
+//  - a brightness map cached by an earlier boot,
+//  - the compiled RGB565 image (the grid is not the one it was compiled for),
+//  - the source JPEG (no compiled assets, e.g. no libjpeg on the build host).
+// Whatever had to be computed is stored in the cache for the next boot.
+static bool load_rain_image(MatrixRain &mr, const fs::path &root, const std::string &name,
+                            espp::Logger &logger) {
+  const fs::path asset_dir = root / "assets";
+  BrightnessCache assets(asset_dir);
+  BrightnessCache cache(root / "cache");
+  BrightnessCache::Key key{
+      .source_hash = 0,
+      .cols = (uint16_t)mr.get_cols(),
+      .rows = (uint16_t)mr.get_rows(),
+      .format = (uint8_t)BrightnessMap::Format::RGB565,
+  };
+  std::vector<uint8_t> brightness_map;
+
+  AssetIndex index;
+  const AssetIndex::Entry *image = nullptr;
+  if (index.load(asset_dir / AssetIndex::file_name)) {
+    // The maps are compiled for the grid of the configured font metrics. On
+    // another grid they can't be used, and the map is computed here instead.
+    for (auto kind : {AssetIndex::Kind::BMSEQ, AssetIndex::Kind::BMAP}) {
+      auto map = index.find(kind, name);
+      if (map && (map->width != key.cols || map->height != key.rows)) {
+        logger.warn("'{}' was compiled for a {}x{} grid, but the rain is {}x{}; check "
+                    "MRP_RAIN_CHAR_WIDTH and MRP_RAIN_LINE_HEIGHT",
+                    map->file, map->width, map->height, key.cols, key.rows);
+      }
+    }
+    auto sequence = index.find(AssetIndex::Kind::BMSEQ, name);
+    if (sequence && mr.set_image_sequence(asset_dir / sequence->file)) {
+      logger.info("Streaming image sequence from '{}'", sequence->file);
+      return true;
+    }
+    image = index.find(AssetIndex::Kind::IMAGE, name);
+  }
+  const fs::path jpeg_file = root / (name + ".jpg");
+  key.source_hash = image ? image->source_hash : BrightnessCache::hash_file(jpeg_file);
+  if (!key.source_hash) {
+    logger.error("No asset or file for image '{}'!", name);
+    return false;
+  }
+
+  for (const auto *source : {&assets, &cache}) {
+    if (source->load(key, brightness_map) &&
+        mr.set_image_brightness_map(std::move(brightness_map))) {
+      logger.info("Loaded brightness map from '{}'", source->path_for(key).string());
+      return true;
+    }
+  }
+
+  lv_image_dsc_t img_desc;
+  memset(&img_desc, 0, sizeof(img_desc));
+  std::vector<uint8_t> pixels;
+  if (image) {
+    // compiled RGB565 pixels, in native byte order
+    pixels.resize(image->width * image->height * 2);
+    std::ifstream stream(asset_dir / image->file, std::ios::binary);
+    if (!stream.read((char *)pixels.data(), pixels.size())) {
+      logger.error("Couldn't read image asset '{}'!", image->file);
+      return false;
+    }
+    img_desc.header.cf = LV_COLOR_FORMAT_RGB565;
+    img_desc.header.w = image->width;
+    img_desc.header.h = image->height;
+    img_desc.data_size = pixels.size();
+    img_desc.data = pixels.data();
+  } else {
+    decoder.decode(jpeg_file.c_str());
+    img_desc.header.cf = LV_COLOR_FORMAT_NATIVE;
+    img_desc.header.w = decoder.get_width();
+    img_desc.header.h = decoder.get_height();
+    img_desc.data_size = decoder.get_size();
+    img_desc.data = decoder.get_decoded_data();
+  }
+  mr.set_image(&img_desc);
+  if (cache.store(key, mr.get_image_brightness_map())) {
+    logger.info("Stored brightness map in '{}'", cache.path_for(key).string());
+  }
+  return true;
+}
+
+#if CONFIG_MRP_RAIN_BENCH_SWEEP
+// Prints how the rain scales with the screen and the font, see RainSweep.
+// The cases run one after the other, with a pause in between so the idle
+// task can feed the task watchdog.
+static void run_rain_sweep(espp::Logger &logger) {
+  RainSweep::Options options;
+  options.frames = CONFIG_MRP_RAIN_BENCH_SWEEP_FRAMES;
+  options.layers = CONFIG_MRP_RAIN_DEPTH_LAYERS;
+  logger.info("Matrix rain sweep: {} frames per case, {} depth layers", options.frames,
+              options.layers);
+  fmt::print("{}\n", RainSweep::header());
+  for (const auto &sweep_case : RainSweep::default_cases()) {
+    fmt::print("{}\n", RainSweep::format(RainSweep::run(sweep_case, options)));
+    std::this_thread::sleep_for(10ms);
+  }
+  logger.info("Free heap after the sweep: {} bytes", heap_caps_get_free_size(MALLOC_CAP_8BIT));
+}
+#endif
+
 extern "C" void app_main(void) {
   static auto start = std::chrono::high_resolution_clock::now();
   static auto elapsed = [&]() {
@@ -41,6 +155,11 @@ extern "C" void app_main(void) {
 
   logger.info("Bootup");
 
+#if CONFIG_MRP_RAIN_BENCH_SWEEP
+  // Before anything else runs, so nothing else competes for the CPU
+  run_rain_sweep(logger);
+#endif
+
   auto &bsp = Bsp::get();
   bsp.set_log_level(espp::Logger::Verbosity::INFO);
 
@@ -69,31 +188,13 @@ extern "C" void app_main(void) {
     return;
   }
 
-  // load the image file (smith.jpg) from the root of the littlefs partition
-  logger.info("Loading image from file system");
-  const fs::path file = espp::FileSystem::get().get_root_path() / "smith.jpg";
-
-  // ensure it exists
-  if (!fs::exists(file)) {
-    logger.error("File '{}' does not exist!", file.string());
-    return;
-  }
-
-  // load the file
-  decoder.decode(file.c_str());
-  // make the descriptor
-  lv_image_dsc_t img_desc;
-  memset(&img_desc, 0, sizeof(img_desc));
-  img_desc.header.cf = LV_COLOR_FORMAT_NATIVE;
-  img_desc.header.w = decoder.get_width();
-  img_desc.header.h = decoder.get_height();
-  img_desc.data_size = decoder.get_size();
-  img_desc.data = decoder.get_decoded_data();
-
   // now initialize the GUI
   Gui gui({});
   if (auto mr = gui.get_matrix_rain()) {
-    mr->set_image(&img_desc);
+    logger.info("Loading image from file system");
+    if (!load_rain_image(*mr, espp::FileSystem::get().get_root_path(), "smith", logger)) {
+      return;
+    }
     mr->set_min_image_brightness(0);
   }
 